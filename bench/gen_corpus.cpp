@@ -0,0 +1,193 @@
+// Synthetic MIDI corpus for profile-guided builds and timing runs: one P1/P2
+// pair per workload the converter is tuned for.  Output is deterministic.
+//
+//   dense    – two tracks of 32nd-note streams with chords (black-MIDI-like)
+//   tempo    – a tempo change every beat, ramping and jumping
+//   sustain  – long, overlapping held notes
+//   many     – 48 thin tracks across all 16 channels
+//
+//   g++ -std=c++17 -O2 bench/gen_corpus.cpp -o gen_corpus
+//   ./gen_corpus <outDir> [scale]      (scale 1 ≈ 300k notes in total)
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// ─── SMF writing ──────────────────────────────────────────────────────────────
+
+struct Event {
+    uint32_t tick;
+    uint8_t  status;   // 0x80/0x90 | channel, or 0xff for tempo
+    uint8_t  a, b;
+    uint32_t tempo;    // µs per quarter (0xff only)
+};
+
+static void put32(std::string& out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) out += static_cast<char>((v >> s) & 0xff);
+}
+
+static void putVarLen(std::string& out, uint32_t v) {
+    char buf[5];
+    int  n = 0;
+    buf[n++] = static_cast<char>(v & 0x7f);
+    while (v >>= 7) buf[n++] = static_cast<char>((v & 0x7f) | 0x80);
+    while (n) out += buf[--n];
+}
+
+// Events are sorted by tick (note-offs first at equal ticks) and written
+// with running status, as sequencers do.
+static std::string trackChunk(std::vector<Event> events) {
+    std::stable_sort(events.begin(), events.end(), [](const Event& x, const Event& y) {
+        if (x.tick != y.tick) return x.tick < y.tick;
+        return (x.status & 0xf0) == 0x80 && (y.status & 0xf0) != 0x80;
+    });
+
+    std::string body;
+    uint32_t last    = 0;
+    uint8_t  running = 0;
+    for (const auto& e : events) {
+        putVarLen(body, e.tick - last);
+        last = e.tick;
+        if (e.status == 0xff) {
+            body += "\xff\x51\x03";
+            for (int s = 16; s >= 0; s -= 8) body += static_cast<char>((e.tempo >> s) & 0xff);
+            running = 0;
+            continue;
+        }
+        if (e.status != running) body += static_cast<char>(e.status);
+        running = e.status;
+        body += static_cast<char>(e.a);
+        body += static_cast<char>(e.b);
+    }
+    putVarLen(body, 0);
+    body += "\xff\x2f";
+    body += '\0';
+
+    std::string chunk = "MTrk";
+    put32(chunk, static_cast<uint32_t>(body.size()));
+    return chunk + body;
+}
+
+static bool writeMidi(const std::string& path, uint16_t ppq,
+                      const std::vector<std::vector<Event>>& tracks) {
+    std::string out = "MThd";
+    put32(out, 6);
+    out += '\0'; out += '\1';   // format 1
+    out += static_cast<char>(tracks.size() >> 8);
+    out += static_cast<char>(tracks.size() & 0xff);
+    out += static_cast<char>(ppq >> 8);
+    out += static_cast<char>(ppq & 0xff);
+    for (const auto& t : tracks) out += trackChunk(t);
+
+    std::ofstream f(path, std::ios::binary);
+    f.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(f);
+}
+
+static void addNote(std::vector<Event>& t, uint32_t tick, uint32_t len, uint8_t ch,
+                    uint8_t pitch, uint8_t vel) {
+    t.push_back({tick,       static_cast<uint8_t>(0x90 | ch), pitch, vel, 0});
+    t.push_back({tick + len, static_cast<uint8_t>(0x80 | ch), pitch, 0,   0});
+}
+
+static std::vector<Event> conductor(uint32_t bpm) {
+    return {{0, 0xff, 0, 0, 60000000u / bpm}};
+}
+
+// ─── Workloads ────────────────────────────────────────────────────────────────
+
+static constexpr uint16_t kPPQ = 480;
+
+static std::vector<std::vector<Event>> dense(std::mt19937& rng, size_t notes) {
+    std::vector<std::vector<Event>> tracks{conductor(180), {}, {}};
+    std::uniform_int_distribution<int> pitch(36, 96), vel(30, 127), chord(1, 4);
+    uint32_t tick = 0;
+    for (size_t n = 0; n < notes;) {
+        int k = chord(rng);
+        for (int c = 0; c < k && n < notes; ++c, ++n)
+            addNote(tracks[1 + (n & 1)], tick, kPPQ / 8 - 1, static_cast<uint8_t>(n & 1),
+                    static_cast<uint8_t>(pitch(rng)), static_cast<uint8_t>(vel(rng)));
+        tick += kPPQ / 8;
+    }
+    return tracks;
+}
+
+static std::vector<std::vector<Event>> tempoHeavy(std::mt19937& rng, size_t notes) {
+    std::vector<std::vector<Event>> tracks{{}, {}};
+    std::uniform_int_distribution<int> pitch(48, 84), jump(0, 15), bpm(70, 240);
+    uint32_t tick = 0;
+    double   cur  = 120.0;
+    for (size_t n = 0; n < notes; ++n, tick += kPPQ / 4) {
+        if (tick % kPPQ == 0) {
+            cur = jump(rng) == 0 ? bpm(rng) : std::min(260.0, std::max(60.0, cur * 1.01));
+            tracks[0].push_back({tick, 0xff, 0, 0, static_cast<uint32_t>(60000000.0 / cur)});
+        }
+        addNote(tracks[1], tick, kPPQ / 4 - 1, 0, static_cast<uint8_t>(pitch(rng)), 100);
+    }
+    return tracks;
+}
+
+static std::vector<std::vector<Event>> sustainHeavy(std::mt19937& rng, size_t notes) {
+    std::vector<std::vector<Event>> tracks{conductor(140), {}};
+    std::uniform_int_distribution<int> pitch(40, 90), len(kPPQ / 2, kPPQ * 6), vel(40, 127);
+    uint32_t tick = 0;
+    for (size_t n = 0; n < notes; ++n, tick += kPPQ / 4)
+        addNote(tracks[1], tick, static_cast<uint32_t>(len(rng)), 0,
+                static_cast<uint8_t>(pitch(rng)), static_cast<uint8_t>(vel(rng)));
+    return tracks;
+}
+
+static std::vector<std::vector<Event>> manyTracks(std::mt19937& rng, size_t notes) {
+    constexpr int kTracks = 48;
+    std::vector<std::vector<Event>> tracks(kTracks + 1);
+    tracks[0] = conductor(150);
+    std::uniform_int_distribution<int> pitch(30, 100), step(1, 8), vel(20, 127);
+    std::vector<uint32_t> ticks(kTracks, 0);
+    for (size_t n = 0; n < notes; ++n) {
+        int t = static_cast<int>(n % kTracks);
+        addNote(tracks[1 + t], ticks[t], kPPQ / 8, static_cast<uint8_t>(t % 16),
+                static_cast<uint8_t>(pitch(rng)), static_cast<uint8_t>(vel(rng)));
+        ticks[t] += static_cast<uint32_t>(step(rng)) * kPPQ / 8;
+    }
+    return tracks;
+}
+
+// ─── Main ─────────────────────────────────────────────────────────────────────
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <outDir> [scale]\n", argv[0]);
+        return 1;
+    }
+    const std::string dir   = argv[1];
+    const double      scale = argc > 2 ? std::max(0.01, std::atof(argv[2])) : 1.0;
+    std::filesystem::create_directories(dir);
+
+    using Gen = std::vector<std::vector<Event>> (*)(std::mt19937&, size_t);
+    const struct { const char* name; Gen gen; size_t notes; } sets[] = {
+        {"dense",   dense,        60000},
+        {"tempo",   tempoHeavy,   20000},
+        {"sustain", sustainHeavy, 25000},
+        {"many",    manyTracks,   40000},
+    };
+
+    std::mt19937 rng(2024);
+    for (const auto& set : sets) {
+        size_t notes = static_cast<size_t>(set.notes * scale);
+        for (int player = 1; player <= 2; ++player) {
+            std::string path = dir + "/" + set.name + "_" + std::to_string(player) + ".mid";
+            if (!writeMidi(path, kPPQ, set.gen(rng, notes))) {
+                std::fprintf(stderr, "failed to write %s\n", path.c_str());
+                return 1;
+            }
+            std::printf("%s (%zu notes)\n", path.c_str(), notes);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Range conversion against the full one.  Each MIDI pair changes tempo just
+// after the range's last tick, inside the range's last section; a range run
+// must still see that change.  Checks the range chart against the full
+// chart's sections (bpm, changeBPM, mustHitSection) and notes in the range,
+// for the run that builds the seek-index sidecar and the one that uses it,
+// then times the three.
+//
+// The pairs differ only in filler events at tick 0, which walk the parser's
+// 4096-event batches across the gap between the range end and the change.
+//
+//   ./range_bench [workDir]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chart_reader.h"
+#include "psych_converter.h"
+
+namespace fs = std::filesystem;
+
+// ─── SMF writing ──────────────────────────────────────────────────────────────
+
+static void put32(std::string& out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) out += static_cast<char>((v >> s) & 0xff);
+}
+
+static void putVarLen(std::string& out, uint32_t v) {
+    char buf[5];
+    int  n = 0;
+    buf[n++] = static_cast<char>(v & 0x7f);
+    while (v >>= 7) buf[n++] = static_cast<char>((v & 0x7f) | 0x80);
+    while (n) out += buf[--n];
+}
+
+constexpr uint16_t kPPQ       = 480;
+constexpr uint32_t kBar       = 4 * kPPQ;
+constexpr uint32_t kChangeAt  = 17 * kBar + 300;   // 120 -> 150 BPM inside section 17
+constexpr double   kRangeFrom = 14000.0;           // ms
+constexpr double   kRangeTo   = 34010.0;           // 10 ms into section 17
+
+// Format 0: the tempo changes share the one track with the notes, so the
+// windowed parse stops reading them at the range end.
+static std::string rangeMidi(size_t filler, int seed) {
+    std::string track;
+    auto tempo = [&](uint32_t delta, uint32_t us) {
+        putVarLen(track, delta);
+        track += "\xff\x51\x03";
+        track += static_cast<char>(us >> 16);
+        track += static_cast<char>(us >> 8);
+        track += static_cast<char>(us);
+    };
+    tempo(0, 500000);
+    for (size_t i = 0; i < filler; ++i) track += std::string("\x00\x90\x14\x00", 4);
+
+    uint32_t last = 0;
+    for (uint32_t t = 0; t < 40000; t += 5) {
+        if (last < kChangeAt && t >= kChangeAt) {
+            tempo(kChangeAt - last, 400000);
+            last = kChangeAt;
+        }
+        const char pitch = static_cast<char>(40 + (t / 5 + seed) % 40);
+        putVarLen(track, t - last);
+        track += '\x90'; track += pitch; track += '\x64';
+        putVarLen(track, 3);
+        track += '\x80'; track += pitch; track += '\x00';
+        last = t + 3;
+    }
+    track.append("\x00\xff\x2f\x00", 4);
+
+    std::string file = "MThd";
+    put32(file, 6);
+    file += std::string("\x00\x00\x00\x01", 4);   // format 0, one track
+    file += static_cast<char>(kPPQ >> 8);
+    file += static_cast<char>(kPPQ & 0xff);
+    file += "MTrk";
+    put32(file, static_cast<uint32_t>(track.size()));
+    return file + track;
+}
+
+// ─── Comparison ───────────────────────────────────────────────────────────────
+
+// Sections from the one holding the range start must agree; the full
+// chart's notes are cut to the range.
+static bool sameInRange(const ChartData& full, const ChartData& range, std::string& why) {
+    const std::vector<double> times = full.sectionTimes();
+    size_t first = 0;
+    while (first + 1 < times.size() && times[first + 1] <= kRangeFrom) ++first;
+
+    if (range.sections.size() > full.sections.size()) {
+        why = "more sections than the full chart";
+        return false;
+    }
+    for (size_t i = first; i < range.sections.size(); ++i) {
+        const Section& f = full.sections[i];
+        const Section& r = range.sections[i];
+        std::vector<ChartNote> kept;
+        for (const auto& n : f.notes)
+            if (n.time >= kRangeFrom && n.time < kRangeTo) kept.push_back(n);
+        if (f.bpm != r.bpm || f.changeBPM != r.changeBPM || f.mustHitSection != r.mustHitSection ||
+            kept != r.notes) {
+            std::ostringstream oss;
+            oss << "section " << i << ": bpm " << r.bpm << (r.changeBPM ? " (change)" : "")
+                << ", " << r.notes.size() << " notes; full chart: bpm " << f.bpm
+                << (f.changeBPM ? " (change)" : "") << ", " << kept.size() << " notes";
+            why = oss.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+// ─── Main ─────────────────────────────────────────────────────────────────────
+
+int main(int argc, char** argv) {
+    const fs::path dir = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path() / "m2p_range_bench";
+    fs::create_directories(dir);
+    const std::string p1 = (dir / "p1.mid").string(), p2 = (dir / "p2.mid").string();
+
+    PsychConverter::Config cfg;
+    cfg.sustainNotes = true;
+    cfg.reuseOutput  = false;
+    PsychConverter fullRun, rangeRun;
+    fullRun.setConfig(cfg);
+    cfg.useRange   = true;
+    cfg.rangeStart = kRangeFrom;
+    cfg.rangeEnd   = kRangeTo;
+    rangeRun.setConfig(cfg);
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    double fullMs = 0.0, buildMs = 0.0, seekMs = 0.0;
+
+    // The converter's own log goes to std::cout; results go to stdout here.
+    std::ostringstream sink;
+    std::streambuf*    console = std::cout.rdbuf(sink.rdbuf());
+
+    int    failures = 0;
+    size_t pairs    = 0;
+    for (size_t filler = 0; filler < 4096; filler += 100, ++pairs) {
+        std::ofstream(p1, std::ios::binary) << rangeMidi(filler, 0);
+        std::ofstream(p2, std::ios::binary) << rangeMidi(filler, 7);
+        fs::remove(p1 + ".seek");
+        fs::remove(p2 + ".seek");
+
+        const std::string outs[] = {(dir / "full.json").string(), (dir / "build.json").string(),
+                                    (dir / "seek.json").string()};
+        double* clocks[] = {&fullMs, &buildMs, &seekMs};
+        ChartData charts[3];
+        for (int k = 0; k < 3; ++k) {
+            auto t0 = Clock::now();
+            bool ok = (k == 0 ? fullRun : rangeRun).convert(p1, p2, outs[k]);
+            *clocks[k] += ms(Clock::now() - t0);
+            ChartReader reader;
+            if (!ok || !reader.read(outs[k], charts[k])) {
+                std::printf("filler %4zu: %s conversion failed\n", filler, k == 0 ? "full" : "range");
+                ++failures;
+                break;
+            }
+            std::string why;
+            if (k > 0 && !sameInRange(charts[0], charts[k], why)) {
+                std::printf("filler %4zu, %s sidecar: %s\n", filler, k == 1 ? "building" : "using",
+                            why.c_str());
+                ++failures;
+            }
+        }
+    }
+    std::cout.rdbuf(console);
+
+    std::printf("%zu MIDI pairs, range %.0f-%.0f ms\n", pairs, kRangeFrom, kRangeTo);
+    std::printf("%-22s %10s\n", "run", "total ms");
+    std::printf("%-22s %10.2f\n", "full", fullMs);
+    std::printf("%-22s %10.2f\n", "range, building index", buildMs);
+    std::printf("%-22s %10.2f\n", "range, using index", seekMs);
+    std::printf("%s\n", failures ? "RANGE OUTPUT DIFFERS" : "range output matches");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+// Section serialisation: each pre-instantiated kernel against the generic
+// per-note-branching path it replaced.  Checks the output is byte-identical,
+// then times both.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/serializer_bench.cpp src/chart_writer.cpp -o serializer_bench
+//   ./serializer_bench [sections] [notesPerSection]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chart_writer.h"
+#include "psych_converter.h"
+#include "utils.h"
+
+// ─── Generic path ─────────────────────────────────────────────────────────────
+
+// The runtime-option serialiser, as it was before the kernels.
+static std::string genericSection(const Section& section, int decimalPlaces, int roundTimesTo,
+                                  bool minify) {
+    std::ostringstream json;
+    double roundMult = roundTimesTo >= 0 ? std::pow(10.0, roundTimesTo) : 0.0;
+
+    json << R"({"sectionNotes":[)";
+    const auto& notes = section.notes;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        if (i > 0) json << ",";
+        double time = notes[i].time;
+        double dur  = notes[i].duration;
+        if (roundMult > 0.0) {
+            time = std::round(time * roundMult) / roundMult;
+            dur  = std::round(dur  * roundMult) / roundMult;
+        }
+        json << "[" << smartNumToStr(time, decimalPlaces) << "," << notes[i].lane << ",0,";
+        if (minify && dur == 0.0) json << "0]";
+        else                      json << smartNumToStr(dur, decimalPlaces) << "]";
+    }
+    json << R"(],"lengthInSteps":16,"mustHitSection":)" << (section.mustHitSection ? "true" : "false")
+         << R"(,"changeBPM":)" << (section.changeBPM ? "true" : "false")
+         << R"(,"bpm":)" << smartNumToStr(section.bpm, decimalPlaces) << "}";
+    return json.str();
+}
+
+// ─── Main ─────────────────────────────────────────────────────────────────────
+
+int main(int argc, char** argv) {
+    const size_t sectionCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    const size_t perSection   = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+
+    // Black-MIDI-like sections: fractional times, a third of notes held.
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> frac(0.0, 1.0);
+    std::vector<Section> sections(sectionCount);
+    double t = 0.0;
+    for (auto& s : sections) {
+        s.mustHitSection = rng() & 1;
+        s.bpm            = 150.0;
+        for (size_t n = 0; n < perSection; ++n) {
+            t += frac(rng) * 25.0;
+            double dur = (rng() % 3 == 0) ? frac(rng) * 400.0 : 0.0;
+            s.notes.emplace_back(t, static_cast<int>(rng() % 8), dur);
+        }
+    }
+
+    struct Variant { const char* name; int roundTo; bool minify; };
+    const Variant variants[] = {
+        {"plain",         -1, false},
+        {"minify",        -1, true },
+        {"round",          2, false},
+        {"round+minify",   2, true },
+    };
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::printf("%zu sections x %zu notes\n", sectionCount, perSection);
+    std::printf("%-14s %12s %12s %8s\n", "variant", "generic ms", "kernel ms", "speedup");
+
+    int failures = 0;
+    for (const auto& v : variants) {
+        SectionFormat fmt;
+        fmt.decimalPlaces = 6;
+        if (v.roundTo >= 0) fmt.roundMult = std::pow(10.0, v.roundTo);
+        SectionWriter write = selectSectionWriter(v.roundTo >= 0, v.minify);
+
+        std::vector<std::string> generic(sections.size()), kernel(sections.size());
+
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < sections.size(); ++i)
+            generic[i] = genericSection(sections[i], fmt.decimalPlaces, v.roundTo, v.minify);
+        auto t1 = Clock::now();
+        for (size_t i = 0; i < sections.size(); ++i)
+            write(kernel[i], sections[i], fmt);
+        auto t2 = Clock::now();
+
+        bool same = generic == kernel;
+        failures += !same;
+        std::printf("%-14s %12.2f %12.2f %7.2fx%s\n", v.name, ms(t1 - t0), ms(t2 - t1),
+                    ms(t1 - t0) / std::max(ms(t2 - t1), 1e-9), same ? "" : "  OUTPUT DIFFERS");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ChartData;
+struct ChartNote;
+struct Section;
+
+// ─── Binary chart format (.m2pc) ──────────────────────────────────────────────
+//
+// Compact intermediate chart between pipeline stages: everything a Psych
+// chart's notes hold, at the converter's own resolution (times and sustains
+// in whole nanoseconds), without the decimal text.  Little-endian, all
+// tables 8-byte aligned so a mapped file is read in place:
+//
+//   Header           64 bytes, "M2PC" + version
+//   strings          song, player1, player2, gfVersion, stage; each NUL-ended
+//   TempoSegment[]   a run of sections sharing one bpm
+//   SectionRecord[]  start time, flags, tempo segment, notes' byte offset
+//   note stream      per note: zigzag varint of its time minus the previous
+//                    note's (the section start for the first), then varint
+//                    of zigzag(lane) << 2 | sustain kind, then the sustain
+//                    (varint ns, or the raw double when it is off that grid)
+//
+// Each section's notes decode on their own, so a loader can start anywhere.
+
+class BinaryChart {
+public:
+    static constexpr char     kMagic[4] = {'M', '2', 'P', 'C'};
+    static constexpr uint16_t kVersion  = 1;
+
+    struct Header {
+        char     magic[4];
+        uint16_t version;
+        uint16_t headerSize;     // sizeof(Header): later versions may grow it
+        double   bpm;            // song "bpm"
+        double   speed;
+        int32_t  mania;
+        uint32_t tempoCount;
+        uint32_t sectionCount;
+        uint32_t stringBytes;
+        uint64_t noteCount;
+        uint64_t noteBytes;
+        uint64_t fileSize;
+    };
+
+    struct TempoSegment {
+        uint32_t firstSection;
+        uint32_t reserved;
+        double   bpm;
+    };
+
+    struct SectionRecord {
+        static constexpr uint32_t kMustHit   = 1;
+        static constexpr uint32_t kChangeBPM = 2;
+
+        int64_t  startNs;        // section start on the chart's grid
+        uint64_t noteOffset;     // into the note stream
+        uint32_t noteCount;
+        uint32_t tempo;          // index into the tempo segments
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    BinaryChart() = default;
+    ~BinaryChart();
+
+    BinaryChart(const BinaryChart&)            = delete;
+    BinaryChart& operator=(const BinaryChart&) = delete;
+
+    // Set when an operation fails: "<file>: reason".
+    std::string errorMessage;
+
+    // True if the file starts with the format's magic.
+    static bool sniff(const std::string& path);
+
+    // ── Writing ─────────────────────────────────────────────────────────────
+    // `meta` supplies the song fields (its sections are not read).  Section
+    // start times are `sectionTimes` (ms, as BuiltChart keeps them) or, if
+    // that is empty, the grid their BPMs lay out.  Written as "<path>.part"
+    // and renamed into place.
+    static bool write(const std::string& path, const ChartData& meta,
+                      const std::vector<Section>& sections, const std::vector<double>& sectionTimes,
+                      std::string& error, uint64_t* bytesWritten = nullptr);
+
+    // ── Reading (memory-mapped, nothing copied until asked) ───────────────
+    bool open(const std::string& path);
+    void close();
+
+    const Header&        header() const { return *m_header; }
+    const TempoSegment*  tempos() const { return m_tempos; }
+    const SectionRecord* sections() const { return m_sections; }
+    std::string_view     songName()  const { return m_strings[0]; }
+    std::string_view     player1()   const { return m_strings[1]; }
+    std::string_view     player2()   const { return m_strings[2]; }
+    std::string_view     gfVersion() const { return m_strings[3]; }
+    std::string_view     stage()     const { return m_strings[4]; }
+
+    // Appends section i's notes to `out`; false if its stream is corrupt.
+    bool decodeNotes(size_t i, std::vector<ChartNote>& out);
+
+    // The whole chart.
+    bool read(ChartData& out);
+
+private:
+    const uint8_t*       m_data     = nullptr;
+    size_t               m_size     = 0;
+    const Header*        m_header   = nullptr;
+    const TempoSegment*  m_tempos   = nullptr;
+    const SectionRecord* m_sections = nullptr;
+    const uint8_t*       m_notes    = nullptr;
+    std::string_view     m_strings[5];
+    std::string          m_path;
+    void*                m_mapping  = nullptr;   // Windows file-mapping handle
+
+    bool fail(const std::string& reason);
+
+    // Platform layer: maps the whole file read-only / releases it.
+    bool map(const std::string& path, std::string& reason);
+    void unmap();
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// ─── Cancellation token ───────────────────────────────────────────────────────
+//
+// Shared by whoever starts a conversion and the pipeline doing it.  cancel()
+// and setDeadline() may be called from any thread; the pipeline polls
+// stopRequested() between chunks of work and unwinds without leaving output.
+
+class CancelToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+    void setDeadline(Clock::time_point t) {
+        m_deadline.store(t.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+    void setTimeout(std::chrono::milliseconds ms) { setDeadline(Clock::now() + ms); }
+
+    bool stopRequested() const {
+        if (m_cancelled.load(std::memory_order_relaxed)) return true;
+        int64_t d = m_deadline.load(std::memory_order_relaxed);
+        return d != kNoDeadline && Clock::now().time_since_epoch().count() >= d;
+    }
+
+    const char* reason() const {
+        return m_cancelled.load(std::memory_order_relaxed) ? "cancelled" : "deadline exceeded";
+    }
+
+private:
+    static constexpr int64_t kNoDeadline = INT64_MAX;
+
+    std::atomic<bool>    m_cancelled{false};
+    std::atomic<int64_t> m_deadline{kNoDeadline};
+};
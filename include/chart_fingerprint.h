@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ─── Output fingerprint ───────────────────────────────────────────────────────
+//
+// Sidecar "<outFile>.m2p" recording what an output was converted from: a hash
+// of the inputs' stamps and every note-affecting option, the chart BPM, and
+// per output file its stamp and how many leading / trailing bytes hold song
+// metadata.  When a later conversion hashes the same, only those bytes are
+// rewritten; the notes between are copied as they are.
+
+struct ChartFingerprint {
+    struct File {
+        std::string name;           // file name, in outFile's directory
+        uint64_t    size     = 0;
+        int64_t     mtime    = 0;
+        uint32_t    metaHead = 0;   // metadata bytes before the notes
+        uint32_t    metaTail = 0;   // and after them
+    };
+
+    uint64_t          sourceHash = 0;
+    double            finalBPM   = 120.0;
+    std::vector<File> files;
+
+    // Fails if the sidecar is missing or malformed, or any listed file
+    // changed since it was saved.
+    bool load(const std::string& outFile);
+
+    // Stamps every file as it is now, then writes the sidecar.
+    bool save(const std::string& outFile);
+
+    // Path of file `name` next to outFile.
+    static std::string pathOf(const std::string& outFile, const std::string& name);
+
+    // FNV-1a over `n` bytes, continuing from `seed`.
+    static uint64_t hash(const void* data, size_t n, uint64_t seed = 14695981039346656037ull);
+
+    // Size and modification time; false if the file can't be read.
+    static bool stamp(const std::string& path, uint64_t& size, int64_t& mtime);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "psych_converter.h"   // Section, ChartNote
+
+// ─── Chart reader ─────────────────────────────────────────────────────────────
+//
+// Reads Psych Engine charts in the layout PsychConverter writes (minified or
+// pretty-printed; unknown fields are skipped) straight into Sections, so a
+// chart can be verified, exported back to MIDI, transcoded or patched.
+// read() takes binary charts (see BinaryChart) and gzip / zstd compressed
+// ones (see StreamCompressor) too.  One pass over the text with no DOM:
+// numbers are parsed in place with std::from_chars (exact, so times
+// round-trip) and each section's notes are allocated once, at their final
+// size.
+//
+// A note is [time, lane, a, b]: the converter writes its sustain as b with
+// a = 0, the Psych chart editor as a (b being an optional note type), so the
+// sustain is whichever of the two is a positive number.
+
+struct ChartData {
+    std::string          songName;
+    std::string          player1   = "bf";
+    std::string          player2   = "dad";
+    std::string          gfVersion = "gf";
+    std::string          stage     = "stage";
+    double               bpm   = 120.0;   // song "bpm": tempo at time 0
+    double               speed = 1.0;
+    int                  mania = 3;       // key count - 1
+    std::vector<Section> sections;
+    size_t               noteCount = 0;
+
+    int keyCount() const { return mania + 1; }
+
+    // Start of each section (ms) on the grid the BPMs lay out, then the end
+    // of the last: a changeBPM section starts at the previous one's bpm.
+    std::vector<double> sectionTimes() const;
+};
+
+class ChartReader {
+public:
+    // Set when a read fails: "<file>: offset N: reason".
+    std::string errorMessage;
+
+    // A chart file, one split file, a shard manifest (its shards are read
+    // from the manifest's directory and placed at their firstSection), or a
+    // binary chart.
+    bool read(const std::string& path, ChartData& out);
+
+    // A chart held in memory.  `name` only labels errors.
+    bool parse(const char* data, size_t size, ChartData& out, const std::string& name = "chart");
+
+    // Byte offsets of a chart's sections in its text, found by matching
+    // brackets and strings only (no values are parsed), so any of them can
+    // be replaced while the rest is copied as it is.
+    struct SectionSpans {
+        size_t arrayBegin = 0;   // song "notes": its '['
+        size_t arrayEnd   = 0;   // and one past its ']'
+        std::vector<std::pair<size_t, size_t>> sections;   // [begin, end) of each
+    };
+
+    // Fails for text without a song "notes" array (a shard manifest).
+    bool locateSections(const std::string& text, SectionSpans& out, const std::string& name = "chart");
+
+    // Whole file into `data`.
+    bool loadFile(const std::string& path, std::string& data);
+
+private:
+    std::vector<ChartNote> m_scratch;   // notes of the section being read
+
+    // loadFile(), decompressed if it is gzip or zstd.
+    bool loadChart(const std::string& path, std::string& data);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+struct Section;
+
+// ─── Section serialisation kernels ────────────────────────────────────────────
+//
+// One kernel per (rounding, minify) combination, instantiated up front and
+// picked once per conversion by selectSectionWriter(), so the per-note loop
+// carries no option tests.  Output is byte-identical to formatting every
+// number with smartNumToStr().
+
+struct SectionFormat {
+    int    decimalPlaces = 6;
+    double roundMult     = 0.0;   // 10^roundTimesTo; only read by rounding kernels
+};
+
+using SectionWriter = void (*)(std::string& out, const Section& section, const SectionFormat& fmt);
+
+// Appends one section's Psych-Engine JSON object to `out`.
+template <bool Round, bool Minify>
+void writeSection(std::string& out, const Section& section, const SectionFormat& fmt);
+
+SectionWriter selectSectionWriter(bool round, bool minify);
+
+// smartNumToStr(num, decimals) appended without a temporary stream.
+void appendNum(std::string& out, double num, int decimals);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ─── CPU feature dispatch ─────────────────────────────────────────────────────
+//
+// Vector kernels are compiled for every ISA level the compiler supports and
+// picked at run time, so one portable binary uses AVX2 / AVX-512 where the
+// host has them.  detected() runs cpuid once; limit() caps the level used
+// (--cpu-features), e.g. to exercise each kernel on one machine.
+
+class CpuFeatures {
+public:
+    enum Level : uint8_t {
+        kScalar,
+        kSSE2,
+        kAVX2,
+        kAVX512    // AVX-512 F + BW
+    };
+
+    // Best level this CPU and build support.
+    static Level detected();
+
+    // Level kernels should use: detected(), capped by limit().
+    static Level active();
+
+    // "auto", "scalar", "sse2", "avx2" or "avx512".  Fails for unknown names
+    // and for levels this CPU can't run.
+    static bool limit(const std::string& spec, std::string& error);
+
+    static const char* name(Level level);
+};
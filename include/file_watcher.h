@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CancelToken;
+
+// ─── File watcher ─────────────────────────────────────────────────────────────
+//
+// Blocks until one of a set of files is rewritten.  Watches the containing
+// directories (inotify on Linux, change notifications on Windows) so saves
+// that write a temp file and rename it over the original are seen too.
+
+class FileWatcher {
+public:
+    explicit FileWatcher(const std::vector<std::string>& files);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&)            = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool ok() const { return m_ok; }
+
+    // Waits for a watched file's size or modification time to change, then
+    // until no further writes arrive for settleMs (editors often save in
+    // several steps).  Returns false if the watch failed or `cancel` fired.
+    bool waitForChange(int settleMs = 50, const CancelToken* cancel = nullptr);
+
+private:
+    struct Watched {
+        std::string path;
+        std::string dir;
+        std::string name;
+        int64_t     mtime = -1;
+        int64_t     size  = -1;
+    };
+
+    std::vector<Watched> m_files;
+    std::vector<void*>   m_handles;   // Windows change-notification handles
+    int                  m_fd = -1;   // inotify descriptor
+    bool                 m_ok = false;
+
+    // Refreshes the recorded stamps; true if any of them changed.
+    bool restamp();
+
+    // Blocks for the next directory event; false on error.  With timeoutMs
+    // >= 0, also returns false if nothing arrives in time (sets timedOut).
+    bool waitEvent(int timeoutMs, bool& timedOut);
+};
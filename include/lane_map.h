@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// ─── Pitch → lane mapping ─────────────────────────────────────────────────────
+//
+// Describes how MIDI pitches become lanes: `pitch % keyCount` (the default),
+// an explicit pitch/pitch-range table, or a General MIDI drum preset.  Before
+// a conversion it is compiled into a 128-entry table for the chart's key
+// count, so assigning a lane is a single load.
+
+class LaneMap {
+public:
+    static constexpr int8_t kDrop = -1;   // compiled entry for unmapped pitches
+
+    using Table = std::array<int8_t, 128>;
+
+    // Spec: "mod" | "drums" | comma list of "pitch:lane" / "lo-hi:lane".
+    // Pitches missing from a list (or a preset) are dropped.  Returns false
+    // with `error` set if the spec is malformed.
+    static bool parse(const std::string& spec, LaneMap& out, std::string& error);
+
+    // Lanes at or beyond keyCount wrap around.
+    Table compile(int keyCount) const;
+
+private:
+    bool                     m_modulo = true;
+    std::array<int16_t, 128> m_lanes{};   // table mode: lane, or -1 = drop
+};
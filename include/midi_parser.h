@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+class CancelToken;
+
 // ─── Data structures ──────────────────────────────────────────────────────────
 
 struct MIDINote {
@@ -15,13 +17,71 @@ struct MIDINote {
 
     MIDINote(uint32_t t, uint8_t n, uint8_t v, uint32_t d = 0)
         : tick(t), note(n), velocity(v), duration(d) {}
+
+    bool operator==(const MIDINote& o) const {
+        return tick == o.tick && note == o.note && velocity == o.velocity && duration == o.duration;
+    }
 };
 
 struct TempoChange {
     uint32_t tick;
     double   bpm;
+    uint32_t usPerQuarter;   // exact Set Tempo value the bpm was derived from
+
+    TempoChange(uint32_t t, double b)
+        : tick(t), bpm(b), usPerQuarter(static_cast<uint32_t>(60000000.0 / b + 0.5)) {}
+    TempoChange(uint32_t t, double b, uint32_t us) : tick(t), bpm(b), usPerQuarter(us) {}
+
+    bool operator==(const TempoChange& o) const {
+        return tick == o.tick && usPerQuarter == o.usPerQuarter && bpm == o.bpm;
+    }
+};
+
+// Decode-time event filter.  Tracks that are not selected are skipped by
+// chunk length; excluded notes are dropped before they are materialised.
+struct MIDIFilter {
+    std::vector<int>         tracks;       // MTrk indices to keep (0-based)
+    std::vector<std::string> trackNames;   // track names to keep (case-insensitive)
+    uint16_t channelMask = 0xffff;         // bit n set = keep MIDI channel n+1
+    uint8_t  minPitch    = 0;
+    uint8_t  maxPitch    = 127;
+    uint8_t  minVelocity = 0;
+    uint8_t  maxVelocity = 127;
+    uint32_t startTick   = 0;              // keep notes starting in [startTick, endTick)
+    uint32_t endTick     = UINT32_MAX;
+
+    // Empty track lists mean "all tracks".
+    bool selectsTracks() const { return !tracks.empty() || !trackNames.empty(); }
+    bool hasWindow()     const { return startTick > 0 || endTick != UINT32_MAX; }
+};
 
-    TempoChange(uint32_t t, double b) : tick(t), bpm(b) {}
+// Where decoding of a track can resume: the scan state at a validation
+// batch boundary.  Events before `pos` all have ticks <= `tick`.
+struct SeekPoint {
+    uint32_t tick;
+    uint32_t pos;             // file offset
+    uint8_t  runningStatus;
+};
+
+// Per-MTrk seek points recorded by a full parse, so a windowed parse of the
+// same file can start each track just before the window.  Tracks holding
+// tempo events are never seeked (the tempo map must stay complete).
+struct SeekIndex {
+    struct Track {
+        bool                   seekable = true;
+        std::vector<SeekPoint> points;
+    };
+
+    uint64_t           fileSize = 0;
+    int64_t            mtime    = 0;
+    std::vector<Track> tracks;
+
+    bool empty() const { return tracks.empty(); }
+
+    // Sidecar "<midiFile>.seek"; load() fails if missing or made for a
+    // different version of the file.
+    bool load(const std::string& midiFile);
+    bool save(const std::string& midiFile) const;
 };
 
 // ─── Parser ───────────────────────────────────────────────────────────────────
@@ -34,19 +94,97 @@ public:
     uint16_t ppq  = 480;
     double   bpm  = 120.0;
 
+    // Set when parse() returns false: "offset 0x…: reason".
+    std::string errorMessage;
+
+    // Track chunks skipped whole by the filter's track selection.
+    int skippedTracks = 0;
+
+    // Input buffer held during the last parse() (released when it returns),
+    // and the decoded tracks/tempo map now held.
+    size_t bufferBytes = 0;
+    size_t resultBytes() const;
+
     // Optional: called with progress in [0,1] as tracks are processed.
     std::function<void(double)> progressCallback;
 
+    // Optional: polled between read chunks, tracks and event batches;
+    // parse() fails with its reason once it fires.
+    const CancelToken* cancelToken = nullptr;
+
+    // Set buildSeekIndex to have parse() record seekIndex.  Otherwise a
+    // seekIndex matching the file lets a windowed parse skip to the window.
+    bool      buildSeekIndex = false;
+    SeekIndex seekIndex;
+
     MIDIParser() = default;
 
-    // Returns false if the file can't be opened or the header is invalid.
+    // Controller-run skip kernel: bytes of [p, e) skipped, advancing the
+    // delta time and running status (see midi_parser.cpp).
+    using RunSkipper = size_t (*)(const uint8_t* p, const uint8_t* e, uint32_t& time,
+                                  uint8_t& runningStatus);
+
+    // Returns false if the file can't be opened or is malformed (see errorMessage).
     bool parse(const std::string& filename, bool sustainNotes, int minVelocity);
+    bool parse(const std::string& filename, bool sustainNotes, const MIDIFilter& filter);
+
+    // Light pre-scan: header and tempo map only (the conductor track of a
+    // format-1 file; every track otherwise).
+    bool parseTempoMap(const std::string& filename);
 
 private:
-    std::vector<uint8_t> m_data;
-    size_t               m_pos = 0;
+    // Note/tempo event located by validateEvents(): absolute tick, offset of
+    // its first data byte in m_data, and its status type (0x80/0x90/0xff).
+    struct IndexedEvent {
+        uint32_t tick;
+        uint32_t pos;
+        uint8_t  type;
+    };
+
+    // Resumable position inside a track chunk between validation batches.
+    struct ScanCursor {
+        size_t   pos;
+        uint32_t tick;
+        uint8_t  runningStatus;
+    };
+
+    // Events validated per batch – keeps m_index cache-resident.
+    static constexpr size_t kIndexBatch = 4096;
+
+    // File read granularity (a cancellation point between chunks).
+    static constexpr size_t kReadChunk = size_t(16) << 20;
 
-    uint32_t readVarLen();
+    std::vector<uint8_t>      m_data;
+    size_t                    m_pos = 0;
+    std::vector<IndexedEvent> m_index;   // reused across batches and tracks
+    size_t                    m_indexCount  = 0;
+    uint16_t                  m_channelMask = 0xffff;   // channels indexed by validateEvents()
+    bool                      m_useSeekIndex = false;
+    bool                      m_tempoOnly    = false;
+    RunSkipper                m_skipRun      = nullptr;   // for CpuFeatures::active(), set by parse()
+
+    // Unchecked readers – only used on ranges already proven in bounds.
     uint16_t read16();
     uint32_t read32();
+
+    // Pass 1: walks events from cur up to end with bounds checks, proving
+    // each read stays inside the chunk, and indexes note/tempo events.
+    // Stops early once kIndexBatch events are indexed.
+    bool validateEvents(ScanCursor& cur, size_t end);
+
+    // Validates and decodes one MTrk chunk batch by batch; pass 2 reads the
+    // indexed events without bounds checks.  `seek` is the track's seek
+    // index entry, recorded into or used to start near filter.startTick.
+    bool parseTrack(size_t begin, size_t end, bool sustainNotes, const MIDIFilter& filter,
+                    SeekIndex::Track* seek);
+
+    // Track-name meta (0x03) among the chunk's leading meta events, or "".
+    std::string readTrackName(size_t begin, size_t end) const;
+
+    bool wantTrack(uint16_t index, size_t begin, size_t end, const MIDIFilter& filter) const;
+
+    bool fail(size_t offset, const char* reason);
+
+    // True (with errorMessage set) once cancelToken has fired.
+    bool stopped();
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct ChartData;
+
+// ─── Chart → MIDI export ──────────────────────────────────────────────────────
+//
+// Writes a chart back out as the two MIDIs it could have been converted from:
+// one per player, each a format-1 file with a conductor track (tempo map, 4/4,
+// song name) and one note track.  Section n starts at bar n at its starting
+// tempo; a changeBPM section switches to its bpm on its last tick (the chart
+// doesn't say where the change really was), so reconverting gives back the
+// same bpm and changeBPM.  Note times are snapped to the nearest tick of that
+// map, and pitches are laid out for the default lane map (lane = pitch % key
+// count, from middle C up; notes stacked in a lane move up by the key count
+// so each keeps its note-off).
+//
+// Taps are zero-length notes when the chart has sustains, so converting
+// with sustains reproduces them; otherwise they are a 16th long.
+
+class MIDIWriter {
+public:
+    // 0 = 3840 (divisible by 96, 192, 240, 384, 480 and 960), halved until
+    // the chart's last tick fits in 32 bits; write() stores the one used.
+    uint16_t ppq      = 0;
+    uint8_t  velocity = 100;
+
+    // Set when write() fails.
+    std::string errorMessage;
+
+    // Notes left out: lanes outside both players' (events, extra keys), and
+    // duplicates stacked past pitch 127.  Set by write().
+    size_t droppedNotes = 0;
+    size_t p1Notes      = 0;
+    size_t p2Notes      = 0;
+
+    bool write(const ChartData& chart, const std::string& p1File, const std::string& p2File);
+};
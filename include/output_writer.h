@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stream_compressor.h"
+
+// ─── Output writer ────────────────────────────────────────────────────────────
+//
+// Double-buffered background writer for a set of output files.  Producers
+// serialise into a file's fill buffer; once full it goes to the I/O thread
+// (pwrite / overlapped WriteFile at its offset) and the producer carries on
+// in the file's second buffer.  Files are written as "<name>.part",
+// preallocated from a size hint and trimmed on close; commit() renames them
+// into place in the order given, so a failed or cancelled run leaves no
+// partial output.  Files that fit one buffer skip both the preallocation
+// and the hand-off and are written on close.
+//
+// With setCompression() every file is compressed on the I/O thread as its
+// buffers arrive, overlapping the producers' serialisation; such files are
+// not preallocated (their size isn't known) and always go through it.
+//
+// Different files may be filled from different threads at once; each file
+// must only be touched by one producer at a time.
+
+class OutputWriter {
+public:
+    explicit OutputWriter(std::vector<std::string> names, size_t bufferBytes = size_t(1) << 20);
+    ~OutputWriter();   // discards anything not committed
+
+    OutputWriter(const OutputWriter&)            = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Set when an operation returns false: "<file>: reason".
+    std::string errorMessage;
+
+    size_t fileCount() const { return m_files.size(); }
+
+    // Compress every file opened after this (level 0 = the codec's default).
+    void setCompression(StreamCompressor::Codec codec, int level) { m_codec = codec; m_level = level; }
+
+    // Creates "<name>.part", preallocated to sizeHint bytes (0 = unknown).
+    bool open(size_t file, size_t sizeHint);
+
+    // The file's fill buffer; append to it, then call flush().
+    std::string& buffer(size_t file) { return m_files[file]->fill; }
+
+    // Hands the fill buffer to the I/O thread once it holds bufferBytes
+    // (or whenever it is non-empty, with force).  False once a write failed.
+    bool flush(size_t file, bool force = false);
+
+    // Copies `n` bytes in, flushing as buffers fill.
+    bool write(size_t file, const char* data, size_t n);
+
+    // Writes out the rest, trims the preallocation and closes the handle.
+    bool close(size_t file);
+
+    // Bytes written to a closed file, and the bytes it was given (the same
+    // unless compressed).
+    uint64_t size(size_t file) const { return m_files[file]->stored; }
+    uint64_t rawSize(size_t file) const { return m_files[file]->offset; }
+
+    // Time the I/O thread spent compressing, over all files.
+    uint64_t compressNs() const { return m_compressNs; }
+
+    // Renames every ".part" into place; discard() removes them instead.
+    bool commit();
+    void discard();
+
+    // Buffer memory held at the busiest point (two buffers per open file).
+    size_t peakBufferBytes() const { return 2 * m_bufferBytes * m_peakOpen; }
+
+private:
+    struct File {
+        std::string name;
+        std::string fill;             // producer side
+        std::string spare;            // returned by the I/O thread
+        uint64_t    offset   = 0;     // end of data handed over so far
+        uint64_t    stored   = 0;     // bytes in the file (I/O thread, if compressed)
+        bool        inFlight = false;
+        bool        isOpen   = false;
+        bool        reserved = false;     // preallocated: trim on close
+        std::atomic<bool> failed{false};
+        std::string error;
+        int         fd       = -1;        // POSIX descriptor
+        void*       handle   = nullptr;   // Windows file handle
+        std::unique_ptr<StreamCompressor> compressor;
+        std::string packed;               // compressor output (I/O thread)
+    };
+
+    struct Job {
+        size_t      file;
+        uint64_t    offset;
+        std::string data;
+        bool        last = false;   // ends a compressed stream
+    };
+
+    std::vector<std::unique_ptr<File>> m_files;
+    size_t                             m_bufferBytes;
+    bool                               m_committed = false;
+    StreamCompressor::Codec            m_codec     = StreamCompressor::kNone;
+    int                                m_level     = 0;
+    std::atomic<uint64_t>              m_compressNs{0};
+
+    std::mutex              m_mutex;
+    std::condition_variable m_jobReady, m_jobDone;
+    std::deque<Job>         m_jobs;
+    bool                    m_stop = false;
+    size_t                  m_openFiles = 0;
+    size_t                  m_peakOpen  = 0;
+    std::thread             m_thread;
+
+    void ioLoop();
+    bool fail(File& f, const std::string& reason);
+
+    // Hands the fill buffer to the I/O thread, whatever it holds.
+    bool handOff(size_t file, bool last);
+
+    // Platform layer.  closeHandle() trims a reserved file to `offset` first.
+    static bool createPart(File& f, size_t reserve, std::string& error);
+    static bool writeAt(File& f, const char* data, size_t n, uint64_t offset, std::string& error);
+    static bool closeHandle(File& f, bool trim);
+};
@@ -2,9 +2,7 @@
 
 #include <string>
 
-#ifdef _WIN32
-  #include <windows.h>
-#endif
+#include "utils.h"   // <windows.h> / HWND
 
 // Simple progress bar wrapper.
 // On Windows it drives a HWND progress-bar control; it always logs to the
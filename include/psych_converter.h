@@ -4,20 +4,29 @@
 #include <string>
 #include <vector>
 
-#ifdef _WIN32
-  #include <windows.h>
-#endif
+#include "chart_writer.h"
+#include "lane_map.h"
+#include "midi_parser.h"   // MIDINote, TempoChange, MIDIFilter
+#include "stream_compressor.h"
+#include "utils.h"         // <windows.h> / HWND
 
-#include "midi_parser.h"   // MIDINote, TempoChange
+class CancelToken;
+class ProgressBar;
 
 // ─── Chart data structures ────────────────────────────────────────────────────
 
 struct ChartNote {
-    double time;
-    int    lane;
-    double duration;
+    double  time;
+    int     lane;
+    uint8_t velocity;   // source MIDI velocity (thinning priority; not serialised)
+    double  duration;
 
-    ChartNote(double t, int l, double d = 0.0) : time(t), lane(l), duration(d) {}
+    ChartNote(double t, int l, double d = 0.0, uint8_t v = 0)
+        : time(t), lane(l), velocity(v), duration(d) {}
+
+    bool operator==(const ChartNote& o) const {
+        return time == o.time && lane == o.lane && duration == o.duration;
+    }
 };
 
 struct Section {
@@ -25,6 +34,11 @@ struct Section {
     bool   mustHitSection = true;
     bool   changeBPM      = false;
     double bpm            = 120.0;
+
+    bool operator==(const Section& o) const {
+        return mustHitSection == o.mustHitSection && changeBPM == o.changeBPM &&
+               bpm == o.bpm && notes == o.notes;
+    }
 };
 
 // ─── Converter ────────────────────────────────────────────────────────────────
@@ -44,6 +58,7 @@ public:
         int     minVelocity   = 0;
         int     decimalPlaces = 6;
         int     mania         = 3;      // 0=1-key, 2=3-key, 3=4-key(default), 4=5-key, etc.
+        LaneMap laneMap;                // pitch → lane (default: pitch % key count)
         bool    highPrecision = true;
         bool    sustainNotes  = false;
         bool    splitOutput   = false;
@@ -51,26 +66,316 @@ public:
         bool    minifyJSON    = false;
         // -1 = off, 0 = integer, 1 = 1 d.p., 2 = 2 d.p., …
         int     roundTimesTo  = -1;
+        // Original per-note double tick→ms maths instead of the fixed-point
+        // tempo map; reproduces charts made before it.
+        bool    legacyTiming  = false;
+        // Decode-time filters per input; minVelocity above is folded in.
+        MIDIFilter p1Filter;
+        MIDIFilter p2Filter;
+        // Sustains running into the next note of their lane (within
+        // sustainGapMs): 0 = leave, 1 = trim to end before it, 2 = make taps.
+        int     sustainOverlap = 0;
+        double  sustainGapMs   = 0.0;
+        // Merge notes of one lane starting within dedupMs of each other
+        // (keeping the longest sustain); < 0 = off, 0 = identical times.
+        double  dedupMs       = -1.0;
+        // Density limits applied after sorting (0 = off): at most maxNPS
+        // notes in any npsWindowMs window, and at least minLaneGapMs between
+        // notes of one lane.  Lowest-velocity notes are dropped first.
+        int     maxNPS        = 0;
+        double  npsWindowMs   = 1000.0;
+        double  minLaneGapMs  = 0.0;
+        // Sharded output: cut on section boundaries once a shard holds
+        // shardBytes of section JSON or spans shardMs (0 = no limit; either
+        // enables it).  outFile becomes a manifest of the shards.
+        size_t  shardBytes    = 0;
+        double  shardMs       = 0.0;
+        // Convert only notes starting in [rangeStart, rangeEnd): chart
+        // milliseconds (before noteOffset), or 1-based inclusive bars of the
+        // section grid when rangeInBars.  Earlier sections stay, empty.
+        bool    useRange      = false;
+        bool    rangeInBars   = false;
+        double  rangeStart    = 0.0;
+        double  rangeEnd      = 0.0;
+        // convert() budget in bytes (0 = none): inputs are parsed one at a
+        // time and JSON is streamed to disk when the projected footprint
+        // needs it; the run fails before allocating if even that won't fit.
+        size_t  maxMemoryBytes = 0;
+        // convert() keeps an existing output's notes when its fingerprint
+        // sidecar shows only song metadata changed (false = always convert).
+        bool    reuseOutput    = true;
+        // Write a binary chart (see BinaryChart) instead of JSON: one file,
+        // whatever the split and shard options.
+        bool    binaryOutput   = false;
+        // Compress JSON output as it is written; every file name gets the
+        // codec's extension.  Level 0 = the codec's default.
+        StreamCompressor::Codec compression      = StreamCompressor::kNone;
+        int                     compressionLevel = 0;
+    };
+
+    // One MIDI input.  Each is parsed with its own filter and lane shift,
+    // and its notes go to one player; any number of inputs may share one.
+    struct Input {
+        std::string file;
+        int         player     = 1;   // 1 = P1 (boyfriend), 2 = P2 (opponent)
+        int         laneOffset = 0;   // added to the mapped lane, wrapping at the key count
+        MIDIFilter  filter;           // the config's minVelocity is folded in
+    };
+
+    // The two standard inputs: p1File with p1Filter, p2File with p2Filter.
+    std::vector<Input> playerInputs(const std::string& p1File, const std::string& p2File) const;
+
+    // One song of a medley: its inputs, and the silence before it (ignored
+    // for the first) in ms or, with gapInBars, in bars at its opening tempo.
+    struct MedleySegment {
+        std::vector<Input> inputs;
+        double             gap       = 0.0;
+        bool               gapInBars = false;
+    };
+
+    // One chart of a multi-difficulty run: a full config (usually the base
+    // config with a few chart-level fields changed) and where to write it.
+    struct Difficulty {
+        std::string name;
+        std::string outFile;
+        Config      config;
     };
 
     void   setConfig(const Config& cfg)  { m_config = cfg; clampConfig(); }
     Config& getConfig()                  { return m_config; }
     void   setProgressHandle(HWND hwnd)  { m_progressHandle = hwnd; }
 
+    // Optional: checked between chunks of every stage.  When it fires the
+    // run stops, writes nothing and returns false.
+    void   setCancelToken(const CancelToken* token) { m_cancel = token; }
+
     // Main entry-point.  Returns true on success.
     bool convert(const std::string& p1File,
                  const std::string& p2File,
                  const std::string& outFile);
 
+    // Any number of inputs, parsed concurrently and merged into one chart.
+    // Timing (PPQ, base BPM) follows the first input; the tempo map is the
+    // first one any input has.  The entry points taking two files convert
+    // playerInputs() of them.
+    bool convert(const std::vector<Input>& inputs, const std::string& outFile);
+
+    // Parses both MIDIs once, with the loosest velocity of all difficulties,
+    // then builds and writes every chart in parallel from the shared notes.
+    // Track/channel/pitch filters and sustain come from this converter's
+    // config; each difficulty may change the chart-level fields (minVelocity,
+    // noteOffset, mania, bpmMultiplier, speed, output options, …).
+    bool convertDifficulties(const std::string& p1File,
+                             const std::string& p2File,
+                             const std::vector<Difficulty>& difficulties);
+    bool convertDifficulties(const std::vector<Input>& inputs,
+                             const std::vector<Difficulty>& difficulties);
+
+    // Several songs back to back in one chart.  Each segment is converted
+    // with its own tempo map and starts on a new section where the one
+    // before ended (after its gap), with changeBPM set where the tempo
+    // differs.  Segments are parsed and built a few at a time in parallel
+    // and streamed to the file in order, each freed once written.  Single
+    // file output only; the song "bpm" is the first segment's.
+    bool convertMedley(const std::vector<MedleySegment>& segments, const std::string& outFile);
+
+    // Converts once, then re-converts whenever either MIDI is saved until
+    // the process ends.  Only sections whose notes or BPM changed are
+    // re-serialised and only changed output files are rewritten.
+    bool watch(const std::string& p1File,
+               const std::string& p2File,
+               const std::string& outFile);
+    bool watch(const std::vector<Input>& inputs, const std::string& outFile);
+
+    // Re-converts only the configured range and splices the sections it
+    // touches into outFile, an existing single-file chart.  Old notes in
+    // those sections outside the range are kept; every other section, and
+    // all text around them, is copied byte for byte.
+    bool patchRange(const std::string& p1File,
+                    const std::string& p2File,
+                    const std::string& outFile);
+    bool patchRange(const std::vector<Input>& inputs, const std::string& outFile);
+
+    // Rewrites a chart in the other format: a binary chart as JSON with this
+    // converter's output options (split, shards, rounding, minify, …), or a
+    // JSON chart (any layout ChartReader takes) as a binary chart.  Song
+    // metadata comes from the chart.
+    bool transcode(const std::string& inFile, const std::string& outFile);
+
+    // Reads a chart this converter wrote (or any Psych chart) and writes it
+    // back out as a MIDI per player; see MIDIWriter for how it is laid out.
+    // ppq 0 picks the finest that fits the chart.
+    bool exportMidi(const std::string& chartFile,
+                    const std::string& p1File,
+                    const std::string& p2File,
+                    uint16_t ppq = 0) const;
+
 private:
+    // Chart built from parsed notes, ready to serialise.
+    struct BuiltChart {
+        std::vector<Section> sections;
+        size_t totalNotes = 0;
+        size_t p1Notes    = 0;
+        double finalBPM   = 120.0;
+        // Start time (ms) of each section, then the end of the last one.
+        std::vector<double> sectionTimes;
+        // Stacked notes merged away; sustains trimmed or made taps.
+        size_t              mergedNotes   = 0;
+        size_t              resolvedHolds = 0;
+        // Notes removed by the density limits, in total and per section.
+        size_t              thinnedNotes = 0;
+        std::vector<size_t> thinnedPerSection;
+        // Capacity of the working note list (freed when buildChart returns).
+        size_t              noteBytes    = 0;
+    };
+
+    struct OutputFile {
+        std::string name;
+        std::string json;
+    };
+
+    // One output file: head, then sections [first, last) joined by ',',
+    // then tail.  The shard manifest is all head.
+    struct OutputPlan {
+        std::string name;
+        std::string head;
+        std::string tail;
+        size_t      first = 0;
+        size_t      last  = 0;
+    };
+
+    // Approximate bytes held by each stage of a conversion (capacities of
+    // the major buffers).
+    struct MemoryUsage {
+        size_t inputBuffers = 0;   // raw MIDI data held at once while parsing
+        size_t decodedNotes = 0;   // parsers' tracks and tempo maps
+        size_t chartNotes   = 0;   // buildChart's working note list
+        size_t sections     = 0;   // built sections
+        size_t output       = 0;   // JSON and write buffers held at once
+
+        size_t parsePeak()  const { return inputBuffers + decodedNotes; }
+        size_t buildPeak()  const { return decodedNotes + chartNotes + sections; }
+        size_t outputPeak() const { return sections + output; }
+        size_t peak() const { return std::max({parsePeak(), buildPeak(), outputPeak()}); }
+    };
+
     Config m_config;
     HWND   m_progressHandle = nullptr;
+    const CancelToken* m_cancel = nullptr;
 
     // Clamp config values to safe ranges
     void clampConfig() {
-        m_config.mania = std::max(0, std::min(m_config.mania, 20));
+        m_config.mania       = std::max(0, std::min(m_config.mania, 20));
+        m_config.minVelocity = std::max(0, std::min(m_config.minVelocity, 127));
+        m_config.bpmMultiplier = std::max(0.001, m_config.bpmMultiplier);
+        m_config.sustainOverlap = std::max(0, std::min(m_config.sustainOverlap, 2));
+        m_config.sustainGapMs   = std::max(0.0, m_config.sustainGapMs);
+        m_config.maxNPS        = std::max(0, m_config.maxNPS);
+        m_config.npsWindowMs   = std::max(1.0, m_config.npsWindowMs);
+        m_config.minLaneGapMs  = std::max(0.0, m_config.minLaneGapMs);
+    }
+
+    bool sharding() const { return m_config.shardBytes > 0 || m_config.shardMs > 0.0; }
+
+    bool stopRequested() const;
+    void logStopped() const;
+
+    // Input filter with a global minVelocity applied.
+    static MIDIFilter effectiveFilter(const MIDIFilter& f, int minVelocity) {
+        MIDIFilter out  = f;
+        out.minVelocity = std::max<uint8_t>(f.minVelocity, static_cast<uint8_t>(minVelocity));
+        return out;
     }
 
+    // Where the configured range lands on the section grid.
+    struct RangeSpan {
+        int64_t startNs = 0, endNs = 0;            // note times kept, before noteOffset
+        size_t  firstSection = 0, endSection = 0;  // sections [first, end) it touches
+    };
+
+    // Tempo-map pre-scan of the inputs → tick window for the configured range.
+    // `tempoMaps` receives the whole-file tempo changes of each input scanned
+    // (up to the first that has any).
+    bool resolveRange(const std::vector<Input>& inputs,
+                      uint32_t& startTick, uint32_t& endTick, bool log,
+                      RangeSpan* span = nullptr,
+                      std::vector<std::vector<TempoChange>>* tempoMaps = nullptr) const;
+
+    // Parses every input with its filter (and the range, using or recording
+    // each input's seek-index sidecar) into parsers[i], on a pool of worker
+    // threads unless `parallel` is false, which holds only one input buffer
+    // at a time.
+    bool parseInputs(const std::vector<Input>& inputs, std::vector<MIDIParser>& parsers,
+                     int minVelocity, bool showProgress = true, bool parallel = true);
+
+    // Folds each lane's stacked notes of time-sorted `notes` into one, in a
+    // single pass.  Returns how many were merged away.
+    size_t mergeStackedNotes(std::vector<ChartNote>& notes, int keyCount) const;
+
+    // Drops notes of time-sorted `notes` that break the density limits;
+    // appends the removed notes' times (ascending) to `removedTimes`.
+    void thinNotes(std::vector<ChartNote>& notes, int keyCount,
+                   std::vector<double>& removedTimes) const;
+
+    // Timing, lane mapping and sectioning under this config.  Notes below
+    // minVelocity are dropped here too, so the parse may be looser.
+    // `bar` may be null (no progress output).
+    BuiltChart buildChart(const std::vector<Input>& inputs, const std::vector<MIDIParser>& parsers,
+                          ProgressBar* bar) const;
+
+    // Output writer buffer size per file (two are held while it is open).
+    static constexpr size_t kOutputBuffer = size_t(1) << 20;
+
+    // Writes each file as "<name>.part" and renames them into place only once
+    // all are written, so a failed or cancelled run leaves no partial output.
+    bool writeFiles(const std::vector<OutputFile>& files) const;
+
+    // Hash of the inputs' paths and stamps and of every option that affects
+    // notes; 0 if an input can't be read or the output is binary.
+    uint64_t sourceHash(const std::vector<Input>& inputs) const;
+
+    // Metadata-only fast path: if outFile's fingerprint matches `hash`,
+    // rewrites just the song metadata of each file around its notes.  False
+    // means convert in full.
+    bool patchMetadata(const std::string& outFile, uint64_t hash) const;
+
+    // Records a full conversion's outputs for patchMetadata().
+    void saveFingerprint(const std::string& outFile, uint64_t hash, double finalBPM,
+                         const std::vector<std::string>& outputFiles) const;
+
+    // Bytes held by built sections.
+    static size_t sectionBytes(const std::vector<Section>& sections);
+
+    void logMemory(const MemoryUsage& mem, bool streamed) const;
+
+    // What writeChart compressed: bytes in, and the I/O thread's time on them.
+    struct CompressionStats {
+        uint64_t rawBytes   = 0;
+        uint64_t compressNs = 0;
+    };
+
+    // "  Compression:   …" stats line (codec, level, ratio, throughput);
+    // empty when output isn't compressed.
+    std::string compressionLine(const CompressionStats& stats, uint64_t storedBytes) const;
+
+    // outFile with the codec's extension, unless it already ends in it.
+    std::string compressedName(const std::string& outFile) const;
+
+    // Writes one JSON (or split files / shards, or a binary chart) and
+    // appends the file names/sizes.  Sections are serialised straight into the output
+    // writer, one producer thread per file.  lowMemory re-serialises shards
+    // instead of keeping them and uses a single producer; `heldBytes`
+    // receives the output memory held at peak, `packed` what compression did.
+    bool writeChart(const BuiltChart& chart, const std::string& outFile,
+                    std::vector<std::string>& outputFiles, size_t& totalFileSize,
+                    bool lowMemory = false, size_t* heldBytes = nullptr,
+                    CompressionStats* packed = nullptr) const;
+
+    void logMidiInfo(const std::vector<MIDIParser>& parsers) const;
+
+    // Notes removed by the density limits, per section (first few).
+    void logThinning(const BuiltChart& chart) const;
+
     // Tick → milliseconds, accounting for all tempo changes.
     double ticksToMs(uint32_t ticks, double finalBPM, uint16_t ppq,
                      const std::vector<TempoChange>& tempoChanges,
@@ -81,10 +386,51 @@ private:
                         const std::vector<std::pair<double, double>>& timeToBPM,
                         double baseBPM) const;
 
-    // Serialise sections to a Psych-Engine JSON string.
-    std::string buildJSON(const std::vector<Section>& sections, double finalBPM) const;
+    // Section serialisation kernel for this config's rounding and minify
+    // options, and the format it reads; chosen once per conversion.
+    SectionWriter sectionWriter() const {
+        return selectSectionWriter(m_config.roundTimesTo >= 0, m_config.minifyJSON);
+    }
+    SectionFormat sectionFormat() const;
+
+    // Song-level fields after "notes" ("bpm" … "validScore"), shared by
+    // charts and shard manifests.
+    std::string songFieldsJSON(double finalBPM) const;
+
+    // Song metadata around the notes: a chart file's head and tail, and the
+    // song object opening a shard manifest.
+    std::string chartHead() const;
+    std::string chartTail(double finalBPM) const;
+    std::string manifestSong(double finalBPM) const;
+
+    // Metadata head and tail of output file `file` of `fileCount`, as
+    // planOutput() lays them out (shards carry none).
+    std::pair<std::string, std::string> fileMetadata(size_t file, size_t fileCount,
+                                                     double finalBPM) const;
+
+    // Divide sections into [first, last) chunks capped at notesPerChunk total notes.
+    std::vector<std::pair<size_t, size_t>> splitSections(const std::vector<Section>& sections,
+                                                         int notesPerChunk) const;
+
+    // Divide sections into [first, last) shards within the byte/time budget.
+    std::vector<std::pair<size_t, size_t>> shardSections(const BuiltChart& chart,
+                                                         const std::vector<size_t>& sectionBytes) const;
+
+    // Output files for this config: one, one per split chunk, or shards
+    // followed by their manifest.  `sectionBytes` (serialised size of each
+    // section) is only read when sharding.  The manifest gives each shard's
+    // JSON size, or `storedBytes[i]` when given (compressed shards, whose
+    // size is only known once written).
+    std::vector<OutputPlan> planOutput(const BuiltChart& chart, const std::string& outFile,
+                                       const std::vector<size_t>& sectionBytes,
+                                       const std::vector<uint64_t>* storedBytes = nullptr) const;
+
+    // Compressed shards are written before their manifest is planned.
+    bool manifestLast() const {
+        return sharding() && m_config.compression != StreamCompressor::kNone;
+    }
 
-    // Divide sections into chunks capped at notesPerChunk total notes.
-    std::vector<std::vector<Section>> splitSections(const std::vector<Section>& sections,
-                                                     int notesPerChunk) const;
+    // planOutput() filled in from already serialised sections.
+    std::vector<OutputFile> renderChart(const BuiltChart& chart, const std::string& outFile,
+                                        const std::vector<std::string>& sectionJSON) const;
 };
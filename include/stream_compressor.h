@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ─── Stream compressor ────────────────────────────────────────────────────────
+//
+// Compresses one output file as it is written, a buffer at a time (gzip
+// through zlib, zstd through libzstd), and decompresses whole files for
+// the chart reader.  Each codec is only built when its library is found
+// (M2P_HAVE_ZLIB / M2P_HAVE_ZSTD); available() says which were.
+
+class StreamCompressor {
+public:
+    enum Codec : uint8_t {
+        kNone,
+        kGzip,
+        kZstd
+    };
+
+    StreamCompressor() = default;
+    ~StreamCompressor();
+
+    StreamCompressor(const StreamCompressor&)            = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    static bool available(Codec codec);
+
+    // "none", "gzip" or "zstd"; the file extension added to outputs (".gz",
+    // ".zst", "" for none); and the level used for 0.
+    static const char* name(Codec codec);
+    static const char* extension(Codec codec);
+    static int         defaultLevel(Codec codec);
+
+    // "none", "gzip" / "gz" or "zstd" / "zst", optionally ":<level>".
+    // Fails for unknown names and for codecs this build lacks.
+    static bool parse(const std::string& spec, Codec& codec, int& level, std::string& error);
+
+    // The codec whose magic starts `data` (kNone if neither).
+    static Codec sniff(const char* data, size_t size);
+
+    // Replaces `data` with its decompressed contents.
+    static bool decompress(Codec codec, std::string& data, std::string& error);
+
+    // ── Streaming ───────────────────────────────────────────────────────────
+    // level 0 = defaultLevel(codec).
+    bool begin(Codec codec, int level, std::string& error);
+
+    // Appends the compressed form of `data` to `out`; `finish` ends the
+    // stream (trailer included), after which begin() starts another.
+    bool compress(const char* data, size_t size, std::string& out, bool finish, std::string& error);
+
+    Codec codec() const { return m_codec; }
+    int   level() const { return m_level; }
+
+private:
+    Codec m_codec  = kNone;
+    int   m_level  = 0;
+    void* m_stream = nullptr;   // z_stream or ZSTD_CCtx
+
+    void end();
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "midi_parser.h"   // TempoChange
+
+// ─── Fixed-point tempo map ────────────────────────────────────────────────────
+//
+// Tick → nanosecond conversion over tempo segments precomputed from the MIDI's
+// integer microseconds-per-quarter values.  Each segment holds its exact start
+// time and a Q24 fixed-point ns-per-tick factor, so converting a note is one
+// integer multiply-add and the result is identical across compilers, LTO and
+// -ffast-math builds.
+
+class TempoMap {
+public:
+    static constexpr int kFracBits = 24;
+
+    // `multiplier` is the BPM multiplier; it is taken to 6 decimal places.
+    TempoMap(uint16_t ppq, const std::vector<TempoChange>& changes, double multiplier);
+
+    int64_t ticksToNs(uint32_t tick) const;
+
+    // First tick whose ticksToNs() is >= ns (inverse for range selection).
+    uint32_t nsToTick(int64_t ns) const;
+
+    static double nsToMs(int64_t ns) { return static_cast<double>(ns) * 1e-6; }
+
+private:
+    struct Segment {
+        uint32_t startTick;
+        int64_t  startNs;     // whole nanoseconds at startTick
+        uint32_t startFrac;   // Q24 remainder carried so segments never drift
+        uint64_t nsPerTick;   // Q24
+    };
+
+    std::vector<Segment> m_segments;   // sorted by startTick, never empty
+};
+
+// (a * b + add) >> kFracBits without overflow.
+inline uint64_t mulAddShiftQ24(uint64_t a, uint64_t b, uint64_t add) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b + add) >> TempoMap::kFracBits);
+#else
+    uint64_t aLo = a & 0xffffffffu, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffffu, bHi = b >> 32;
+    uint64_t ll  = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+    uint64_t lo  = (mid << 32) | (ll & 0xffffffffu);
+    uint64_t hi  = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    uint64_t sum = lo + add;
+    hi += (sum < lo);
+    return (sum >> TempoMap::kFracBits) | (hi << (64 - TempoMap::kFracBits));
+#endif
+}
+
+inline int64_t TempoMap::ticksToNs(uint32_t tick) const {
+    // Last segment starting at or before tick (segments are few; tick-sorted
+    // inputs mostly hit the same one).
+    size_t lo = 0, hi = m_segments.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (m_segments[mid].startTick <= tick) lo = mid;
+        else                                  hi = mid;
+    }
+    const Segment& s = m_segments[lo];
+    uint64_t half = uint64_t(1) << (kFracBits - 1);
+    return s.startNs + static_cast<int64_t>(
+        mulAddShiftQ24(tick - s.startTick, s.nsPerTick, s.startFrac + half));
+}
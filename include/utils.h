@@ -15,6 +15,7 @@
       SetConsoleMode(h, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING); }
 #else
   #define ENABLE_COLORS()
+  typedef void* HWND;   // window handles are accepted and ignored off Windows
 #endif
 
 // ─── ANSI colour codes ────────────────────────────────────────────────────────
@@ -10,7 +10,8 @@ title MIDI2Psych Builder
 :: -- CONFIG --------------------------------------------------
 set BUILD_TYPE=debug
 :: Options: release | debug | asan
-::   release  -> -O3, -march=native, -flto, stripped binary
+::   release  -> -O3, -flto, stripped binary (portable: SIMD kernels are
+::               picked at run time from the CPU's features)
 ::   debug    -> -O0, -g, full symbols, assertions on
 ::   asan     -> -O1, -g, AddressSanitizer (MinGW support varies)
 
@@ -66,6 +67,22 @@ for /f "tokens=1,2,3" %%A in ('g++ --version 2^>^&1') do (
 )
 :compiler_found
 echo  >> Compiler : !COMPILER_VER!
+
+:: -- Optional libraries (--compress codecs) ------------------
+set LIB_FLAGS=
+set LIB_LINK=
+echo #include ^<zlib.h^> | g++ -E -x c++ - >nul 2>&1
+if !ERRORLEVEL! equ 0 (
+    set LIB_FLAGS=!LIB_FLAGS! -DM2P_HAVE_ZLIB
+    set LIB_LINK=!LIB_LINK! -lz
+    echo  >> zlib     : found ^(--compress gzip^)
+)
+echo #include ^<zstd.h^> | g++ -E -x c++ - >nul 2>&1
+if !ERRORLEVEL! equ 0 (
+    set LIB_FLAGS=!LIB_FLAGS! -DM2P_HAVE_ZSTD
+    set LIB_LINK=!LIB_LINK! -lzstd
+    echo  >> zstd     : found ^(--compress zstd^)
+)
 echo.
 
 :: -- Resolve paths -------------------------------------------
@@ -78,7 +95,7 @@ set INCLUDE_DIR=%REPO_ROOT%include
 :: -- Verify required source files exist ----------------------
 echo  [*] Checking source files...
 set MISSING_FILES=0
-for %%F in (main.cpp midi_parser.cpp psych_converter.cpp gui.cpp gui_logger.cpp progress_bar.cpp) do (
+for %%F in (main.cpp midi_parser.cpp cpu_features.cpp seek_index.cpp lane_map.cpp chart_writer.cpp chart_fingerprint.cpp binary_chart.cpp chart_reader.cpp midi_writer.cpp output_writer.cpp psych_converter.cpp tempo_map.cpp file_watcher.cpp gui.cpp gui_logger.cpp progress_bar.cpp stream_compressor.cpp) do (
     if not exist "%SRC_DIR%\%%F" (
         call :print_warn "Missing: src\%%F"
         set /a MISSING_FILES+=1
@@ -103,7 +120,7 @@ if not exist "%OUT_DIR%" (
 
 :: -- Build flags by profile ----------------------------------
 if /i "%BUILD_TYPE%"=="release" (
-    set OPT_FLAGS=-O3 -march=native -flto -s -DNDEBUG
+    set OPT_FLAGS=-O3 -flto -s -DNDEBUG
     set OUT_NAME=midi2psych.exe
 ) else if /i "%BUILD_TYPE%"=="debug" (
     set OPT_FLAGS=-O0 -g -DDEBUG
@@ -139,16 +156,29 @@ g++ -std=%STD% ^
     %OPT_FLAGS% ^
     %WARN_FLAGS% ^
     %EXTRA_FLAGS% ^
+    %LIB_FLAGS% ^
     -I"%INCLUDE_DIR%" ^
     -mwindows ^
     -o "%OUT_DIR%\%OUT_NAME%" ^
     "%SRC_DIR%\main.cpp" ^
     "%SRC_DIR%\midi_parser.cpp" ^
+    "%SRC_DIR%\cpu_features.cpp" ^
+    "%SRC_DIR%\seek_index.cpp" ^
+    "%SRC_DIR%\lane_map.cpp" ^
+    "%SRC_DIR%\chart_writer.cpp" ^
+    "%SRC_DIR%\chart_fingerprint.cpp" ^
+    "%SRC_DIR%\binary_chart.cpp" ^
+    "%SRC_DIR%\chart_reader.cpp" ^
+    "%SRC_DIR%\midi_writer.cpp" ^
+    "%SRC_DIR%\output_writer.cpp" ^
     "%SRC_DIR%\psych_converter.cpp" ^
+    "%SRC_DIR%\tempo_map.cpp" ^
+    "%SRC_DIR%\file_watcher.cpp" ^
     "%SRC_DIR%\gui.cpp" ^
     "%SRC_DIR%\gui_logger.cpp" ^
     "%SRC_DIR%\progress_bar.cpp" ^
-    -lcomctl32 -lcomdlg32 -lgdi32 -lshell32 2>&1
+    "%SRC_DIR%\stream_compressor.cpp" ^
+    %LIB_LINK% -lcomctl32 -lcomdlg32 -lgdi32 -lshell32 2>&1
 
 set BUILD_RESULT=%ERRORLEVEL%
 
@@ -185,7 +215,6 @@ echo.
 echo  Common causes:
 echo    - Syntax error in your source files (check above)
 echo    - Missing #include or mismatched header
-echo    - -march=native unsupported on your CPU (try removing it)
 echo    - -flto issues: remove it from OPT_FLAGS in this script
 echo.
 pause
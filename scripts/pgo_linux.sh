@@ -0,0 +1,103 @@
+#!/bin/sh
+# ============================================================
+#  MIDI2Psych profile-guided build for Linux (GCC or Clang)
+#
+#  Usually run as `cmake --build <build> --target pgo`; standalone:
+#    sh scripts/pgo_linux.sh <repo> <work dir> <gen_corpus> [scale] [c++ compiler]
+#
+#  1. builds a plain release converter           -> <work>/plain
+#  2. builds an instrumented converter            -> <work>/build
+#  3. converts the synthetic corpus with it, collecting the profile
+#  4. rebuilds <work>/build with the profile      -> <work>/midi2psych
+#  5. times plain vs PGO over the corpus and reports the speedup
+# ============================================================
+set -e
+
+SRC=$1
+WORK=$2
+GEN=$3
+SCALE=${4:-1}
+CXX_BIN=${5:-c++}
+CMAKE=${CMAKE:-cmake}
+ROUNDS=${ROUNDS:-5}
+
+if [ -z "$SRC" ] || [ -z "$WORK" ] || [ -z "$GEN" ]; then
+    echo "usage: $0 <repo> <work dir> <gen_corpus> [scale] [c++ compiler]" >&2
+    exit 1
+fi
+
+CORPUS=$WORK/corpus
+PROFILE=$WORK/profile
+OUT=$WORK/out
+JOBS=$(nproc 2>/dev/null || echo 2)
+
+configure() {   # <dir> <pgo stage>
+    "$CMAKE" -S "$SRC" -B "$1" -DCMAKE_BUILD_TYPE=Release -DCMAKE_CXX_COMPILER="$CXX_BIN" \
+        -DM2P_PGO="$2" -DM2P_PGO_DIR="$PROFILE" > /dev/null
+}
+
+build() {       # <dir>
+    "$CMAKE" --build "$1" --target midi2psych --clean-first -j "$JOBS" > /dev/null
+}
+
+# One pass over the corpus with the option mixes the converter is used with.
+run_corpus() {  # <binary>
+    mkdir -p "$OUT"
+    for set in dense tempo sustain many; do
+        for opts in "" "--sustain --minify" "--split 20000 --round 2" \
+                    "--legacy-timing --mania 5" "--dedup 0 --max-nps 40 --sustain-overlap trim"; do
+            # shellcheck disable=SC2086
+            "$1" "$CORPUS/${set}_1.mid" "$CORPUS/${set}_2.mid" "$OUT/$set.json" $opts > /dev/null
+        done
+    done
+}
+
+# One corpus pass, in ms.
+time_corpus() { # <binary>
+    t0=$(date +%s%N)
+    run_corpus "$1"
+    t1=$(date +%s%N)
+    echo $(( (t1 - t0) / 1000000 ))
+}
+
+echo " [*] Generating corpus (scale $SCALE)"
+"$GEN" "$CORPUS" "$SCALE" > /dev/null
+
+echo " [*] Building plain release"
+configure "$WORK/plain" ""
+build "$WORK/plain"
+
+echo " [*] Building instrumented"
+rm -rf "$PROFILE"
+configure "$WORK/build" generate
+build "$WORK/build"
+
+echo " [*] Training on corpus"
+run_corpus "$WORK/build/midi2psych"
+
+if ls "$PROFILE"/*.profraw > /dev/null 2>&1; then   # Clang
+    llvm-profdata merge -o "$PROFILE/default.profdata" "$PROFILE"/*.profraw
+fi
+
+echo " [*] Building with profile"
+configure "$WORK/build" use
+build "$WORK/build"
+cp "$WORK/build/midi2psych" "$WORK/midi2psych"
+
+echo " [*] Timing corpus, best of $ROUNDS (interleaved)"
+plain=
+pgo=
+i=0
+while [ $i -lt "$ROUNDS" ]; do
+    a=$(time_corpus "$WORK/plain/midi2psych")
+    b=$(time_corpus "$WORK/midi2psych")
+    if [ -z "$plain" ] || [ "$a" -lt "$plain" ]; then plain=$a; fi
+    if [ -z "$pgo" ]   || [ "$b" -lt "$pgo" ];   then pgo=$b;   fi
+    i=$((i + 1))
+done
+
+echo
+echo "  Plain release : $plain ms"
+echo "  PGO           : $pgo ms"
+awk -v a="$plain" -v b="$pgo" 'BEGIN { if (b > 0) printf "  Speedup       : %.2fx\n", a / b }'
+echo "  Binary        : $WORK/midi2psych"
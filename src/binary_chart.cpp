@@ -0,0 +1,435 @@
+#include "binary_chart.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "chart_reader.h"
+#include "output_writer.h"
+#include "psych_converter.h"   // Section, ChartNote
+#include "tempo_map.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+static_assert(sizeof(BinaryChart::Header)        == 64, "header layout");
+static_assert(sizeof(BinaryChart::TempoSegment)  == 16, "tempo segment layout");
+static_assert(sizeof(BinaryChart::SectionRecord) == 32, "section record layout");
+
+namespace {
+
+// ─── Layout ───────────────────────────────────────────────────────────────────
+
+constexpr size_t kStringCount = 5;
+
+uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+struct Layout {
+    uint64_t strings, tempos, sections, notes, end;
+
+    explicit Layout(const BinaryChart::Header& h) {
+        strings  = h.headerSize;
+        tempos   = align8(strings + h.stringBytes);
+        sections = tempos + uint64_t(h.tempoCount) * sizeof(BinaryChart::TempoSegment);
+        notes    = sections + uint64_t(h.sectionCount) * sizeof(BinaryChart::SectionRecord);
+        end      = notes + h.noteBytes;
+    }
+};
+
+// ─── Varints ──────────────────────────────────────────────────────────────────
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t  unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+size_t varintSize(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) { v >>= 7; ++n; }
+    return n;
+}
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>(0x80 | (v & 0x7f));
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// How a note's sustain follows its lane: a trimmed hold is a difference of
+// two times, so it can miss the nanosecond grid and is then kept as it is.
+enum SustainKind : uint64_t { kNoSustain = 0, kSustainNs = 1, kSustainRaw = 2 };
+
+// One note's fields as stored.
+struct Packed {
+    uint64_t time;    // zigzag delta
+    uint64_t lane;    // zigzag(lane) << 2 | SustainKind
+    uint64_t sustain; // ns, or the double's bits
+};
+
+Packed pack(const ChartNote& n, int64_t& prevNs) {
+    const int64_t ns = std::llround(n.time * 1e6);
+    Packed p{zigzag(ns - prevNs), zigzag(n.lane) << 2, 0};
+    if (n.duration > 0.0) {
+        const int64_t dur = std::llround(n.duration * 1e6);
+        if (TempoMap::nsToMs(dur) == n.duration) {
+            p.lane   |= kSustainNs;
+            p.sustain = static_cast<uint64_t>(dur);
+        } else {
+            p.lane |= kSustainRaw;
+            std::memcpy(&p.sustain, &n.duration, sizeof(double));
+        }
+    }
+    prevNs = ns;
+    return p;
+}
+
+size_t packedSize(const Packed& p) {
+    switch (p.lane & 3) {
+        case kSustainNs:  return varintSize(p.time) + varintSize(p.lane) + varintSize(p.sustain);
+        case kSustainRaw: return varintSize(p.time) + varintSize(p.lane) + sizeof(double);
+        default:          return varintSize(p.time) + varintSize(p.lane);
+    }
+}
+
+} // namespace
+
+// ─── sniff ────────────────────────────────────────────────────────────────────
+
+bool BinaryChart::sniff(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    return in.read(magic, 4) && std::memcmp(magic, kMagic, 4) == 0;
+}
+
+// ─── write ────────────────────────────────────────────────────────────────────
+
+bool BinaryChart::write(const std::string& path, const ChartData& meta,
+                        const std::vector<Section>& sections,
+                        const std::vector<double>& sectionTimes, std::string& error,
+                        uint64_t* bytesWritten) {
+    if (sections.size() > UINT32_MAX) {
+        error = path + ": too many sections";
+        return false;
+    }
+
+    // ── Tables: tempo runs, section starts and note byte offsets ───────────
+    std::vector<TempoSegment>  tempos;
+    std::vector<SectionRecord> records(sections.size());
+    std::vector<double>        grid;
+    if (sectionTimes.size() < sections.size()) {
+        ChartData timing;
+        timing.bpm = meta.bpm;
+        timing.sections.reserve(sections.size());
+        for (const auto& s : sections) {
+            timing.sections.emplace_back();
+            timing.sections.back().bpm       = s.bpm;
+            timing.sections.back().changeBPM = s.changeBPM;
+        }
+        grid = timing.sectionTimes();
+    }
+    const std::vector<double>& times = grid.empty() ? sectionTimes : grid;
+    uint64_t noteBytes = 0;
+    uint64_t noteCount = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const Section& s = sections[i];
+        if (s.notes.size() > UINT32_MAX) {
+            error = path + ": section " + std::to_string(i) + " has too many notes";
+            return false;
+        }
+        if (tempos.empty() || tempos.back().bpm != s.bpm)
+            tempos.push_back({static_cast<uint32_t>(i), 0, s.bpm});
+
+        SectionRecord& r = records[i];
+        r.startNs    = std::llround(times[i] * 1e6);
+        r.noteOffset = noteBytes;
+        r.noteCount  = static_cast<uint32_t>(s.notes.size());
+        r.tempo      = static_cast<uint32_t>(tempos.size() - 1);
+        r.flags      = (s.mustHitSection ? SectionRecord::kMustHit : 0) |
+                       (s.changeBPM ? SectionRecord::kChangeBPM : 0);
+        r.reserved   = 0;
+
+        int64_t prev = r.startNs;
+        for (const auto& n : s.notes) noteBytes += packedSize(pack(n, prev));
+        noteCount += s.notes.size();
+    }
+
+    std::string strings;
+    for (const std::string* str : {&meta.songName, &meta.player1, &meta.player2,
+                                   &meta.gfVersion, &meta.stage}) {
+        strings += *str;
+        strings += '\0';
+    }
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, 4);
+    h.version      = kVersion;
+    h.headerSize   = sizeof(Header);
+    h.bpm          = meta.bpm;
+    h.speed        = meta.speed;
+    h.mania        = meta.mania;
+    h.tempoCount   = static_cast<uint32_t>(tempos.size());
+    h.sectionCount = static_cast<uint32_t>(sections.size());
+    h.stringBytes  = static_cast<uint32_t>(strings.size());
+    h.noteCount    = noteCount;
+    h.noteBytes    = noteBytes;
+    const Layout at(h);
+    h.fileSize     = at.end;
+
+    // ── File: tables, then the note stream encoded straight into the buffer ─
+    OutputWriter writer({path});
+    auto put = [&](const void* data, size_t n) {
+        return writer.write(0, static_cast<const char*>(data), n);
+    };
+    static const char zeros[8] = {};
+    bool ok = writer.open(0, static_cast<size_t>(at.end)) && put(&h, sizeof(h)) &&
+              put(strings.data(), strings.size()) &&
+              put(zeros, static_cast<size_t>(at.tempos - at.strings - strings.size())) &&
+              put(tempos.data(), tempos.size() * sizeof(TempoSegment)) &&
+              put(records.data(), records.size() * sizeof(SectionRecord));
+
+    std::string& buf = writer.buffer(0);
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        int64_t prev = records[i].startNs;
+        for (const auto& n : sections[i].notes) {
+            const Packed p = pack(n, prev);
+            putVarint(buf, p.time);
+            putVarint(buf, p.lane);
+            if ((p.lane & 3) == kSustainNs)  putVarint(buf, p.sustain);
+            if ((p.lane & 3) == kSustainRaw) buf.append(reinterpret_cast<const char*>(&p.sustain), sizeof(double));
+        }
+        ok = writer.flush(0);
+    }
+    if (!ok || !writer.close(0) || !writer.commit()) {
+        error = writer.errorMessage;
+        return false;
+    }
+    if (bytesWritten) *bytesWritten = writer.size(0);
+    return true;
+}
+
+// ─── Platform layer ───────────────────────────────────────────────────────────
+
+#ifdef _WIN32
+
+bool BinaryChart::map(const std::string& path, std::string& reason) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        reason = "cannot open file";
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Header))) {
+        CloseHandle(file);
+        reason = "not a binary chart (too small)";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);   // the mapping keeps the file open
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        reason = "cannot map file (error " + std::to_string(GetLastError()) + ")";
+        if (mapping) CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data    = static_cast<const uint8_t*>(view);
+    m_size    = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void BinaryChart::unmap() {
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    m_mapping = nullptr;
+}
+
+#else
+
+bool BinaryChart::map(const std::string& path, std::string& reason) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        reason = "cannot open file";
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        reason = "not a binary chart (too small)";
+        return false;
+    }
+    void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // the mapping keeps the file open
+    if (view == MAP_FAILED) {
+        reason = std::string("cannot map file: ") + std::strerror(errno);
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void BinaryChart::unmap() { ::munmap(const_cast<uint8_t*>(m_data), m_size); }
+
+#endif
+
+// ─── open / close ─────────────────────────────────────────────────────────────
+
+BinaryChart::~BinaryChart() { close(); }
+
+bool BinaryChart::fail(const std::string& reason) {
+    errorMessage = m_path + ": " + reason;
+    close();
+    return false;
+}
+
+bool BinaryChart::open(const std::string& path) {
+    close();
+    m_path = path;
+    std::string reason;
+    if (!map(path, reason)) return fail(reason);
+
+    // ── Validate the header and tables; note streams are checked as decoded ─
+    m_header = reinterpret_cast<const Header*>(m_data);
+    const Header& h = *m_header;
+    if (std::memcmp(h.magic, kMagic, 4) != 0) return fail("not a binary chart");
+    if (h.version != kVersion)
+        return fail("unsupported binary chart version " + std::to_string(h.version));
+    if (h.headerSize < sizeof(Header) || h.headerSize % 8 != 0) return fail("corrupt header");
+
+    // Each table must fit in what is left of the file.  Checked by
+    // subtraction before any offset is formed, so corrupt counts can't wrap
+    // the layout around to a plausible end.
+    const uint64_t size = m_size;
+    uint64_t       next = h.headerSize;
+    bool           fits = next <= size && h.stringBytes <= size - next;
+    if (fits) {
+        next = align8(next + h.stringBytes);
+        fits = next <= size && h.tempoCount <= (size - next) / sizeof(TempoSegment);
+    }
+    if (fits) {
+        next += uint64_t(h.tempoCount) * sizeof(TempoSegment);
+        fits  = h.sectionCount <= (size - next) / sizeof(SectionRecord);
+    }
+    if (fits) {
+        next += uint64_t(h.sectionCount) * sizeof(SectionRecord);
+        fits  = h.noteBytes == size - next;
+    }
+    if (!fits || h.fileSize != m_size)
+        return fail("truncated or corrupt (size " + std::to_string(m_size) + ")");
+    const Layout at(h);
+
+    m_tempos   = reinterpret_cast<const TempoSegment*>(m_data + at.tempos);
+    m_sections = reinterpret_cast<const SectionRecord*>(m_data + at.sections);
+    m_notes    = m_data + at.notes;
+
+    const char* str = reinterpret_cast<const char*>(m_data + at.strings);
+    const char* end = str + h.stringBytes;
+    for (size_t i = 0; i < kStringCount; ++i) {
+        const char* nul = static_cast<const char*>(std::memchr(str, '\0', end - str));
+        if (!nul) return fail("corrupt string table");
+        m_strings[i] = std::string_view(str, nul - str);
+        str = nul + 1;
+    }
+
+    // Every note takes at least two bytes, so counts past that are corrupt
+    // rather than something to reserve memory for.
+    uint64_t noteCount = 0;
+    for (uint32_t i = 0; i < h.sectionCount; ++i) {
+        const SectionRecord& r = m_sections[i];
+        if (r.tempo >= h.tempoCount || r.noteOffset > h.noteBytes ||
+            r.noteCount > (h.noteBytes - r.noteOffset) / 2)
+            return fail("corrupt section " + std::to_string(i));
+        noteCount += r.noteCount;
+    }
+    if (noteCount != h.noteCount) return fail("corrupt note count");
+    return true;
+}
+
+void BinaryChart::close() {
+    if (m_data) unmap();
+    m_data     = nullptr;
+    m_size     = 0;
+    m_header   = nullptr;
+    m_tempos   = nullptr;
+    m_sections = nullptr;
+    m_notes    = nullptr;
+    for (auto& s : m_strings) s = {};
+}
+
+// ─── decode ───────────────────────────────────────────────────────────────────
+
+bool BinaryChart::decodeNotes(size_t i, std::vector<ChartNote>& out) {
+    const SectionRecord& r   = m_sections[i];
+    const uint8_t*       p   = m_notes + r.noteOffset;
+    const uint8_t*       end = m_notes + m_header->noteBytes;
+    int64_t              ns  = r.startNs;
+    for (uint32_t n = 0; n < r.noteCount; ++n) {
+        uint64_t delta, lane, sustain = 0;
+        double   duration = 0.0;
+        bool     ok = getVarint(p, end, delta) && getVarint(p, end, lane);
+        if (ok && (lane & 3) == kSustainNs) {
+            ok       = getVarint(p, end, sustain);
+            duration = TempoMap::nsToMs(static_cast<int64_t>(sustain));
+        } else if (ok && (lane & 3) == kSustainRaw) {
+            ok = end - p >= static_cast<ptrdiff_t>(sizeof(double));
+            if (ok) std::memcpy(&duration, p, sizeof(double));
+            p += ok ? sizeof(double) : 0;
+        } else {
+            ok = ok && (lane & 3) == kNoSustain;
+        }
+        if (!ok) {
+            errorMessage = m_path + ": corrupt notes in section " + std::to_string(i);
+            return false;
+        }
+        ns += unzigzag(delta);
+        out.emplace_back(TempoMap::nsToMs(ns), static_cast<int>(unzigzag(lane >> 2)), duration);
+    }
+    return true;
+}
+
+bool BinaryChart::read(ChartData& out) {
+    if (!m_data) {
+        errorMessage = m_path + ": not open";
+        return false;
+    }
+    const Header& h = *m_header;
+    out           = ChartData{};
+    out.songName  = std::string(songName());
+    out.player1   = std::string(player1());
+    out.player2   = std::string(player2());
+    out.gfVersion = std::string(gfVersion());
+    out.stage     = std::string(stage());
+    out.bpm       = h.bpm;
+    out.speed     = h.speed;
+    out.mania     = h.mania;
+
+    out.sections.resize(h.sectionCount);
+    for (uint32_t i = 0; i < h.sectionCount; ++i) {
+        const SectionRecord& r = m_sections[i];
+        Section&             s = out.sections[i];
+        s.bpm            = m_tempos[r.tempo].bpm;
+        s.mustHitSection = (r.flags & SectionRecord::kMustHit) != 0;
+        s.changeBPM      = (r.flags & SectionRecord::kChangeBPM) != 0;
+        s.notes.reserve(r.noteCount);
+        if (!decodeNotes(i, s.notes)) return false;
+        out.noteCount += s.notes.size();
+    }
+    return true;
+}
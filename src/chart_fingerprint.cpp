@@ -0,0 +1,112 @@
+#include "chart_fingerprint.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// ─── Sidecar format ───────────────────────────────────────────────────────────
+//
+//   "M2PFPRT1"  u64 sourceHash  f64 finalBPM  u32 fileCount
+//   per file:   u32 nameLength  name  u64 size  i64 mtime  u32 metaHead  u32 metaTail
+//
+// Little-endian as written by the host; a foreign or stale sidecar just
+// fails to load and the chart is converted in full.
+
+namespace {
+
+constexpr char kMagic[8] = {'M', '2', 'P', 'F', 'P', 'R', 'T', '1'};
+
+std::string sidecarPath(const std::string& outFile) { return outFile + ".m2p"; }
+
+template <typename T> void put(std::ofstream& out, T v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+template <typename T> bool get(std::ifstream& in, T& v) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(v)));
+}
+
+} // namespace
+
+// ─── Helpers ──────────────────────────────────────────────────────────────────
+
+std::string ChartFingerprint::pathOf(const std::string& outFile, const std::string& name) {
+    return (std::filesystem::path(outFile).parent_path() / name).string();
+}
+
+uint64_t ChartFingerprint::hash(const void* data, size_t n, uint64_t seed) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        seed ^= p[i];
+        seed *= 1099511628211ull;
+    }
+    return seed;
+}
+
+bool ChartFingerprint::stamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec) return false;
+    auto t = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(t.time_since_epoch().count());
+    return true;
+}
+
+// ─── load ─────────────────────────────────────────────────────────────────────
+
+bool ChartFingerprint::load(const std::string& outFile) {
+    *this = ChartFingerprint{};
+
+    std::ifstream in(sidecarPath(outFile), std::ios::binary);
+    char magic[8];
+    if (!in || !in.read(magic, 8) || std::memcmp(magic, kMagic, 8) != 0) return false;
+
+    ChartFingerprint fp;
+    uint32_t         count;
+    if (!get(in, fp.sourceHash) || !get(in, fp.finalBPM) || !get(in, count)) return false;
+    if (count == 0 || count > 1u << 20) return false;
+
+    fp.files.resize(count);
+    for (auto& f : fp.files) {
+        uint32_t length;
+        if (!get(in, length) || length == 0 || length > 4096) return false;
+        f.name.resize(length);
+        if (!in.read(&f.name[0], length)) return false;
+        if (!get(in, f.size) || !get(in, f.mtime) || !get(in, f.metaHead) || !get(in, f.metaTail))
+            return false;
+        if (uint64_t(f.metaHead) + f.metaTail > f.size) return false;
+
+        uint64_t size;
+        int64_t  mtime;
+        if (!stamp(pathOf(outFile, f.name), size, mtime) || size != f.size || mtime != f.mtime)
+            return false;
+    }
+
+    *this = std::move(fp);
+    return true;
+}
+
+// ─── save ─────────────────────────────────────────────────────────────────────
+
+bool ChartFingerprint::save(const std::string& outFile) {
+    for (auto& f : files)
+        if (!stamp(pathOf(outFile, f.name), f.size, f.mtime)) return false;
+
+    std::ofstream out(sidecarPath(outFile), std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    out.write(kMagic, 8);
+    put(out, sourceHash);
+    put(out, finalBPM);
+    put(out, static_cast<uint32_t>(files.size()));
+    for (const auto& f : files) {
+        put(out, static_cast<uint32_t>(f.name.size()));
+        out.write(f.name.data(), static_cast<std::streamsize>(f.name.size()));
+        put(out, f.size);
+        put(out, f.mtime);
+        put(out, f.metaHead);
+        put(out, f.metaTail);
+    }
+    return static_cast<bool>(out);
+}
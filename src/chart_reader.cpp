@@ -0,0 +1,444 @@
+#include "chart_reader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "binary_chart.h"
+#include "stream_compressor.h"
+
+namespace {
+
+// ─── Scanner ──────────────────────────────────────────────────────────────────
+//
+// Just enough JSON for charts: members are visited in place, anything not
+// asked for is skipped without being stored.
+
+class Scanner {
+public:
+    Scanner(const char* data, size_t size) : m_begin(data), m_p(data), m_end(data + size) {}
+
+    std::string error;
+
+    void ws() {
+        while (m_p < m_end && static_cast<unsigned char>(*m_p) <= ' ') ++m_p;
+    }
+
+    bool fail(const char* what) {
+        if (error.empty()) error = "offset " + std::to_string(m_p - m_begin) + ": " + what;
+        return false;
+    }
+
+    bool eat(char c) {
+        ws();
+        if (m_p < m_end && *m_p == c) { ++m_p; return true; }
+        return false;
+    }
+
+    bool atEnd() { ws(); return m_p == m_end; }
+
+    size_t offset() const { return static_cast<size_t>(m_p - m_begin); }
+
+    bool peekNumber() {
+        ws();
+        return m_p < m_end && (*m_p == '-' || (*m_p >= '0' && *m_p <= '9'));
+    }
+
+    bool number(double& v) {
+        ws();
+        auto r = std::from_chars(m_p, m_end, v);
+        if (r.ec != std::errc()) return fail("expected a number");
+        m_p = r.ptr;
+        return true;
+    }
+
+    bool integer(int& v) {
+        double d;
+        if (!number(d)) return false;
+        v = static_cast<int>(d);
+        return true;
+    }
+
+    bool boolean(bool& v) {
+        ws();
+        if (m_end - m_p >= 4 && std::memcmp(m_p, "true", 4) == 0)  { v = true;  m_p += 4; return true; }
+        if (m_end - m_p >= 5 && std::memcmp(m_p, "false", 5) == 0) { v = false; m_p += 5; return true; }
+        return fail("expected true or false");
+    }
+
+    // Contents between the quotes, escapes left in place.
+    bool rawString(std::string_view& s) {
+        ws();
+        if (m_p >= m_end || *m_p != '"') return fail("expected a string");
+        const char* start = ++m_p;
+        for (;;) {
+            auto q = static_cast<const char*>(std::memchr(m_p, '"', static_cast<size_t>(m_end - m_p)));
+            if (!q) return fail("unterminated string");
+            const char* b = q;
+            while (b > start && b[-1] == '\\') --b;
+            m_p = q + 1;
+            if (((q - b) & 1) == 0) {
+                s = std::string_view(start, static_cast<size_t>(q - start));
+                return true;
+            }
+        }
+    }
+
+    bool string(std::string& out) {
+        std::string_view raw;
+        if (!rawString(raw)) return false;
+        out.clear();
+        for (size_t i = 0; i < raw.size(); ++i) {
+            char c = raw[i];
+            if (c != '\\' || i + 1 == raw.size()) { out += c; continue; }
+            switch (c = raw[++i]) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {   // BMP code point → UTF-8
+                    unsigned cp = 0;
+                    auto r = std::from_chars(raw.data() + i + 1,
+                                             raw.data() + std::min(raw.size(), i + 5), cp, 16);
+                    i = static_cast<size_t>(r.ptr - raw.data()) - 1;
+                    if (cp < 0x80) {
+                        out += static_cast<char>(cp);
+                    } else if (cp < 0x800) {
+                        out += static_cast<char>(0xc0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3f));
+                    } else {
+                        out += static_cast<char>(0xe0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                        out += static_cast<char>(0x80 | (cp & 0x3f));
+                    }
+                    break;
+                }
+                default: out += c;   // \" \\ \/
+            }
+        }
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        ws();
+        if (m_p >= m_end) return fail("unexpected end of input");
+        switch (*m_p) {
+            case '{':
+                if (depth > 64) return fail("nested too deeply");
+                return object([&](std::string_view) { return skipValue(depth + 1); });
+            case '[':
+                if (depth > 64) return fail("nested too deeply");
+                return array([&]() { return skipValue(depth + 1); });
+            case '"': {
+                std::string_view s;
+                return rawString(s);
+            }
+            case 't': case 'f': {
+                bool b;
+                return boolean(b);
+            }
+            case 'n':
+                if (m_end - m_p >= 4 && std::memcmp(m_p, "null", 4) == 0) { m_p += 4; return true; }
+                return fail("unexpected token");
+            default: {
+                double d;
+                return number(d);
+            }
+        }
+    }
+
+    // An object or array skipped by matching brackets outside strings; what
+    // is inside is not checked.
+    bool skipBalanced() {
+        ws();
+        if (m_p >= m_end || (*m_p != '{' && *m_p != '[')) return fail("expected '{' or '['");
+        int depth = 0;
+        while (m_p < m_end) {
+            char c = *m_p;
+            if (c == '"') {
+                std::string_view s;
+                if (!rawString(s)) return false;
+                continue;
+            }
+            ++m_p;
+            if (c == '{' || c == '[')                           ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)    return true;
+        }
+        return fail("unterminated object or array");
+    }
+
+    // Calls member(key) with the scanner at each value; it must consume it.
+    template <typename F> bool object(F&& member) {
+        if (!eat('{')) return fail("expected '{'");
+        if (eat('}')) return true;
+        do {
+            std::string_view key;
+            if (!rawString(key)) return false;
+            if (!eat(':')) return fail("expected ':'");
+            if (!member(key)) return false;
+        } while (eat(','));
+        return eat('}') || fail("expected ',' or '}'");
+    }
+
+    // Calls element() at each array element; it must consume it.
+    template <typename F> bool array(F&& element) {
+        if (!eat('[')) return fail("expected '['");
+        if (eat(']')) return true;
+        do {
+            if (!element()) return false;
+        } while (eat(','));
+        return eat(']') || fail("expected ',' or ']'");
+    }
+
+private:
+    const char* m_begin;
+    const char* m_p;
+    const char* m_end;
+};
+
+// What the top level of a file held besides the song itself.
+struct TopLevel {
+    size_t                                   firstSection = 0;   // shard files
+    std::vector<std::pair<std::string, size_t>> shards;          // manifests: file, firstSection
+};
+
+// ─── Schema ───────────────────────────────────────────────────────────────────
+
+bool parseNotes(Scanner& sc, std::vector<ChartNote>& notes) {
+    return sc.array([&]() {
+        double v[4] = {0.0, 0.0, 0.0, 0.0};
+        int    n    = 0;
+        bool ok = sc.array([&]() {
+            bool numeric = n < 4 && sc.peekNumber();
+            ++n;
+            return numeric ? sc.number(v[n - 1]) : sc.skipValue();
+        });
+        if (!ok) return false;
+        if (n < 2) return sc.fail("a note needs a time and a lane");
+        double sustain = v[2] > 0.0 ? v[2] : (v[3] > 0.0 ? v[3] : 0.0);
+        notes.emplace_back(v[0], static_cast<int>(v[1]), sustain);
+        return true;
+    });
+}
+
+bool parseSections(Scanner& sc, std::vector<Section>& sections, double songBPM,
+                   std::vector<ChartNote>& scratch) {
+    return sc.array([&]() {
+        Section section;
+        // Sections without a "bpm" keep the one before them.
+        section.bpm = sections.empty() ? songBPM : sections.back().bpm;
+        scratch.clear();
+        bool ok = sc.object([&](std::string_view key) {
+            if (key == "sectionNotes")   return parseNotes(sc, scratch);
+            if (key == "mustHitSection") return sc.boolean(section.mustHitSection);
+            if (key == "changeBPM")      return sc.boolean(section.changeBPM);
+            if (key == "bpm")            return sc.number(section.bpm);
+            return sc.skipValue();
+        });
+        if (!ok) return false;
+        section.notes.assign(scratch.begin(), scratch.end());   // one exact allocation
+        sections.push_back(std::move(section));
+        return true;
+    });
+}
+
+bool parseSong(Scanner& sc, ChartData& out, std::vector<ChartNote>& scratch) {
+    // "bpm" follows "notes" in converter output: sections missing their own
+    // bpm are fixed up once the song's is known.
+    bool   hasBPM = false;
+    size_t first  = out.sections.size();
+    bool ok = sc.object([&](std::string_view key) {
+        if (key == "song")      return sc.string(out.songName);
+        if (key == "player1")   return sc.string(out.player1);
+        if (key == "player2")   return sc.string(out.player2);
+        if (key == "gfVersion") return sc.string(out.gfVersion);
+        if (key == "stage")     return sc.string(out.stage);
+        if (key == "speed")     return sc.number(out.speed);
+        if (key == "mania")     return sc.integer(out.mania);
+        if (key == "bpm") {
+            hasBPM = true;
+            return sc.number(out.bpm);
+        }
+        if (key == "notes") {
+            const double kUnset = -1.0;
+            return parseSections(sc, out.sections, hasBPM ? out.bpm : kUnset, scratch);
+        }
+        return sc.skipValue();
+    });
+    if (!ok) return false;
+    // The unset ones are a prefix: the first explicit bpm carries forward.
+    for (size_t s = first; s < out.sections.size() && out.sections[s].bpm < 0.0; ++s)
+        out.sections[s].bpm = out.bpm;
+    return true;
+}
+
+bool parseTop(Scanner& sc, ChartData& out, TopLevel& top, std::vector<ChartNote>& scratch) {
+    bool ok = sc.object([&](std::string_view key) {
+        if (key == "song") return parseSong(sc, out, scratch);
+        if (key == "notes") return parseSections(sc, out.sections, out.bpm, scratch);
+        if (key == "firstSection") {
+            double first;
+            if (!sc.number(first)) return false;
+            top.firstSection = static_cast<size_t>(first);
+            return true;
+        }
+        if (key == "shards") {
+            return sc.array([&]() {
+                std::pair<std::string, size_t> shard{"", 0};
+                return sc.object([&](std::string_view k) {
+                    if (k == "file") return sc.string(shard.first);
+                    if (k == "firstSection") {
+                        double first;
+                        if (!sc.number(first)) return false;
+                        shard.second = static_cast<size_t>(first);
+                        top.shards.push_back(shard);
+                        return true;
+                    }
+                    return sc.skipValue();
+                });
+            });
+        }
+        return sc.skipValue();
+    });
+    return ok && (sc.atEnd() || sc.fail("trailing data after the chart"));
+}
+
+} // namespace
+
+// ─── ChartData ────────────────────────────────────────────────────────────────
+
+std::vector<double> ChartData::sectionTimes() const {
+    std::vector<double> times;
+    times.reserve(sections.size() + 1);
+    double time   = 0.0;
+    double endBPM = bpm;   // tempo at the end of the previous section
+    for (const auto& s : sections) {
+        times.push_back(time);
+        time  += (60000.0 / (s.changeBPM ? endBPM : s.bpm)) * 4;
+        endBPM = s.bpm;
+    }
+    times.push_back(time);
+    return times;
+}
+
+// ─── parse / read ─────────────────────────────────────────────────────────────
+
+bool ChartReader::parse(const char* data, size_t size, ChartData& out, const std::string& name) {
+    out = ChartData{};
+    Scanner  sc(data, size);
+    TopLevel top;
+    if (!parseTop(sc, out, top, m_scratch)) {
+        errorMessage = name + ": " + sc.error;
+        return false;
+    }
+    for (const auto& section : out.sections) out.noteCount += section.notes.size();
+    return true;
+}
+
+bool ChartReader::loadFile(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        errorMessage = path + ": cannot open file";
+        return false;
+    }
+    data.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+        errorMessage = path + ": read failed";
+        return false;
+    }
+    return true;
+}
+
+bool ChartReader::loadChart(const std::string& path, std::string& data) {
+    if (!loadFile(path, data)) return false;
+    std::string error;
+    if (!StreamCompressor::decompress(StreamCompressor::sniff(data.data(), data.size()), data, error)) {
+        errorMessage = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool ChartReader::read(const std::string& path, ChartData& out) {
+    out = ChartData{};
+    if (BinaryChart::sniff(path)) {
+        BinaryChart bin;
+        if (bin.open(path) && bin.read(out)) return true;
+        errorMessage = bin.errorMessage;
+        return false;
+    }
+
+    std::string data;
+    if (!loadChart(path, data)) return false;
+
+    Scanner  sc(data.data(), data.size());
+    TopLevel top;
+    if (!parseTop(sc, out, top, m_scratch)) {
+        errorMessage = path + ": " + sc.error;
+        return false;
+    }
+
+    // Shard manifest: the sections live in the listed files.
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    for (const auto& [file, listedFirst] : top.shards) {
+        const std::string shardPath = (dir / file).string();
+        if (!loadChart(shardPath, data)) return false;
+
+        ChartData part;
+        part.bpm = out.bpm;
+        Scanner  shard(data.data(), data.size());
+        TopLevel shardTop;
+        if (!parseTop(shard, part, shardTop, m_scratch)) {
+            errorMessage = shardPath + ": " + shard.error;
+            return false;
+        }
+        size_t first = shardTop.firstSection ? shardTop.firstSection : listedFirst;
+        if (out.sections.size() < first + part.sections.size())
+            out.sections.resize(first + part.sections.size());
+        for (size_t s = 0; s < part.sections.size(); ++s)
+            out.sections[first + s] = std::move(part.sections[s]);
+    }
+
+    for (const auto& section : out.sections) out.noteCount += section.notes.size();
+    return true;
+}
+
+// ─── locateSections ───────────────────────────────────────────────────────────
+
+bool ChartReader::locateSections(const std::string& text, SectionSpans& out,
+                                 const std::string& name) {
+    out = SectionSpans{};
+    Scanner sc(text.data(), text.size());
+    bool    found = false;
+    bool ok = sc.object([&](std::string_view key) {
+        if (key != "song") return sc.skipValue();
+        return sc.object([&](std::string_view k) {
+            if (k != "notes") return sc.skipValue();
+            found = true;
+            sc.ws();
+            out.arrayBegin = sc.offset();
+            bool sections = sc.array([&]() {
+                sc.ws();
+                size_t begin = sc.offset();
+                if (!sc.skipBalanced()) return false;
+                out.sections.push_back({begin, sc.offset()});
+                return true;
+            });
+            out.arrayEnd = sc.offset();
+            return sections;
+        });
+    });
+    if (ok && !found) sc.fail("no song \"notes\" (shard manifests can't be patched)");
+    if (!ok || !found) {
+        errorMessage = name + ": " + sc.error;
+        return false;
+    }
+    return true;
+}
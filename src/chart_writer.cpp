@@ -0,0 +1,84 @@
+#include "chart_writer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "psych_converter.h"   // Section
+#include "utils.h"
+
+// ─── Numbers ──────────────────────────────────────────────────────────────────
+
+void appendNum(std::string& out, double num, int decimals) {
+    char buf[352];   // "%.*f" of any double at the usual precisions
+    if (std::floor(num) == num) {
+        int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(num));
+        out.append(buf, static_cast<size_t>(len));
+        return;
+    }
+
+    int len = std::snprintf(buf, sizeof(buf), "%.*f", decimals, num);
+    if (len < 0 || static_cast<size_t>(len) >= sizeof(buf)) {
+        out += smartNumToStr(num, decimals);   // absurd precision: take the slow path
+        return;
+    }
+
+    // Same trimming as smartNumToStr(): zeros after the point, then the point.
+    if (const char* dot = static_cast<const char*>(std::memchr(buf, '.', static_cast<size_t>(len)))) {
+        int lastNonZero = len - 1;
+        while (lastNonZero >= 0 && buf[lastNonZero] == '0') --lastNonZero;
+        if (buf + lastNonZero > dot) len = lastNonZero + 1;
+        if (buf[len - 1] == '.') --len;
+    }
+    out.append(buf, static_cast<size_t>(len));
+}
+
+// ─── Kernels ──────────────────────────────────────────────────────────────────
+
+template <bool Round, bool Minify>
+void writeSection(std::string& out, const Section& section, const SectionFormat& fmt) {
+    const int dp = fmt.decimalPlaces;
+
+    out += R"({"sectionNotes":[)";
+    const auto& notes = section.notes;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        if (i > 0) out += ',';
+
+        double time = notes[i].time;
+        double dur  = notes[i].duration;
+        if constexpr (Round) {
+            time = std::round(time * fmt.roundMult) / fmt.roundMult;
+            dur  = std::round(dur  * fmt.roundMult) / fmt.roundMult;
+        }
+
+        out += '[';
+        appendNum(out, time, dp);
+        out += ',';
+        out += std::to_string(notes[i].lane);
+        out += ",0,";
+        if constexpr (Minify) {
+            if (dur == 0.0) { out += "0]"; continue; }
+        }
+        appendNum(out, dur, dp);
+        out += ']';
+    }
+
+    out += R"(],"lengthInSteps":16,"mustHitSection":)";
+    out += section.mustHitSection ? "true" : "false";
+    out += R"(,"changeBPM":)";
+    out += section.changeBPM ? "true" : "false";
+    out += R"(,"bpm":)";
+    appendNum(out, section.bpm, dp);
+    out += '}';
+}
+
+template void writeSection<false, false>(std::string&, const Section&, const SectionFormat&);
+template void writeSection<false, true >(std::string&, const Section&, const SectionFormat&);
+template void writeSection<true,  false>(std::string&, const Section&, const SectionFormat&);
+template void writeSection<true,  true >(std::string&, const Section&, const SectionFormat&);
+
+SectionWriter selectSectionWriter(bool round, bool minify) {
+    if (round) return minify ? &writeSection<true, true>  : &writeSection<true, false>;
+    return            minify ? &writeSection<false, true> : &writeSection<false, false>;
+}
@@ -0,0 +1,63 @@
+#include "cpu_features.h"
+
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #define M2P_X86_DISPATCH 1
+#endif
+
+namespace {
+
+std::atomic<uint8_t> g_limit{CpuFeatures::kAVX512};
+
+CpuFeatures::Level detect() {
+#ifdef M2P_X86_DISPATCH
+    __builtin_cpu_init();
+    // __builtin_cpu_supports also checks the OS saves the wider registers.
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return CpuFeatures::kAVX512;
+    if (__builtin_cpu_supports("avx2")) return CpuFeatures::kAVX2;
+    if (__builtin_cpu_supports("sse2")) return CpuFeatures::kSSE2;
+#endif
+    return CpuFeatures::kScalar;
+}
+
+} // namespace
+
+CpuFeatures::Level CpuFeatures::detected() {
+    static const Level level = detect();
+    return level;
+}
+
+CpuFeatures::Level CpuFeatures::active() {
+    Level cap = static_cast<Level>(g_limit.load(std::memory_order_relaxed));
+    return detected() < cap ? detected() : cap;
+}
+
+bool CpuFeatures::limit(const std::string& spec, std::string& error) {
+    Level level;
+    if      (spec == "auto")   level = kAVX512;
+    else if (spec == "scalar") level = kScalar;
+    else if (spec == "sse2")   level = kSSE2;
+    else if (spec == "avx2")   level = kAVX2;
+    else if (spec == "avx512") level = kAVX512;
+    else {
+        error = "unknown level '" + spec + "' (auto, scalar, sse2, avx2, avx512)";
+        return false;
+    }
+    if (spec != "auto" && level > detected()) {
+        error = std::string("this CPU supports up to ") + name(detected());
+        return false;
+    }
+    g_limit.store(level, std::memory_order_relaxed);
+    return true;
+}
+
+const char* CpuFeatures::name(Level level) {
+    switch (level) {
+        case kSSE2:   return "sse2";
+        case kAVX2:   return "avx2";
+        case kAVX512: return "avx512";
+        default:      return "scalar";
+    }
+}
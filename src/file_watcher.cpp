@@ -0,0 +1,129 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include "cancel_token.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#else
+  #include <chrono>
+  #include <thread>
+#endif
+
+namespace fs = std::filesystem;
+
+// ─── Constructor / destructor ─────────────────────────────────────────────────
+
+FileWatcher::FileWatcher(const std::vector<std::string>& files) {
+    std::vector<std::string> dirs;
+    for (const auto& f : files) {
+        fs::path p = fs::absolute(fs::path(f));
+        Watched w;
+        w.path = p.string();
+        w.dir  = p.parent_path().string();
+        w.name = p.filename().string();
+        m_files.push_back(w);
+        if (std::find(dirs.begin(), dirs.end(), w.dir) == dirs.end())
+            dirs.push_back(w.dir);
+    }
+    restamp();
+
+#ifdef _WIN32
+    for (const auto& d : dirs) {
+        HANDLE h = FindFirstChangeNotificationA(d.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+        if (h == INVALID_HANDLE_VALUE) return;
+        m_handles.push_back(h);
+    }
+    m_ok = !m_handles.empty();
+#elif defined(__linux__)
+    m_fd = inotify_init1(IN_CLOEXEC);
+    if (m_fd < 0) return;
+    for (const auto& d : dirs) {
+        if (inotify_add_watch(m_fd, d.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE) < 0)
+            return;
+    }
+    m_ok = true;
+#else
+    m_ok = true;   // polled
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef _WIN32
+    for (void* h : m_handles) FindCloseChangeNotification(static_cast<HANDLE>(h));
+#elif defined(__linux__)
+    if (m_fd >= 0) close(m_fd);
+#endif
+}
+
+// ─── restamp ──────────────────────────────────────────────────────────────────
+
+bool FileWatcher::restamp() {
+    bool changed = false;
+    for (auto& w : m_files) {
+        std::error_code ec;
+        int64_t size  = static_cast<int64_t>(fs::file_size(w.path, ec));
+        if (ec) size = -1;
+        auto    time  = fs::last_write_time(w.path, ec);
+        int64_t mtime = ec ? -1 : static_cast<int64_t>(time.time_since_epoch().count());
+        if (size != w.size || mtime != w.mtime) changed = true;
+        w.size  = size;
+        w.mtime = mtime;
+    }
+    return changed;
+}
+
+// ─── waitEvent ────────────────────────────────────────────────────────────────
+
+bool FileWatcher::waitEvent(int timeoutMs, bool& timedOut) {
+    timedOut = false;
+#ifdef _WIN32
+    DWORD r = WaitForMultipleObjects(static_cast<DWORD>(m_handles.size()),
+                                     reinterpret_cast<HANDLE*>(m_handles.data()), FALSE,
+                                     timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+    if (r == WAIT_TIMEOUT) { timedOut = true; return false; }
+    if (r >= WAIT_OBJECT_0 + m_handles.size()) return false;
+    return FindNextChangeNotification(static_cast<HANDLE>(m_handles[r - WAIT_OBJECT_0])) != 0;
+#elif defined(__linux__)
+    pollfd pfd{m_fd, POLLIN, 0};
+    int r = poll(&pfd, 1, timeoutMs);
+    if (r == 0) { timedOut = true; return false; }
+    if (r < 0)  return false;
+
+    // Drain; the stamps decide whether a watched file actually changed.
+    alignas(inotify_event) char buf[4096];
+    return read(m_fd, buf, sizeof(buf)) > 0;
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs < 0 ? 100 : std::min(timeoutMs, 100)));
+    if (timeoutMs >= 0) timedOut = true;
+    return timeoutMs < 0;
+#endif
+}
+
+// ─── waitForChange ───────────────────────────────────────────────────────────
+
+bool FileWatcher::waitForChange(int settleMs, const CancelToken* cancel) {
+    if (!m_ok) return false;
+
+    // With a token, wake periodically to poll it (and re-stat the files).
+    const int slice = cancel ? 200 : -1;
+    bool timedOut;
+    do {
+        if (cancel && cancel->stopRequested()) return false;
+        if (!waitEvent(slice, timedOut) && !timedOut) return false;
+    } while (!restamp());
+
+    // Let the writer finish.
+    while (waitEvent(settleMs, timedOut)) {}
+    if (!timedOut) return false;
+    restamp();
+    return true;
+}
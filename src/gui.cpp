@@ -5,9 +5,12 @@
 #include <commctrl.h>
 #include <commdlg.h>
 #include <richedit.h>
+#include <memory>
 #include <thread>
 #include <vector>
 
+#include "cancel_token.h"
+#include "cpu_features.h"
 #include "gui_logger.h"
 #include "psych_converter.h"
 #include "utils.h"
@@ -28,6 +31,9 @@ HWND g_hSplitCheck   = nullptr, g_hMinifyCheck    = nullptr;
 HFONT g_hFont        = nullptr, g_hTitleFont = nullptr, g_hConsoleFont = nullptr;
 bool  g_converting   = false;
 
+// Token of the running conversion; the worker thread holds its own reference.
+static std::shared_ptr<CancelToken> g_cancelToken;
+
 // ─── Helpers ──────────────────────────────────────────────────────────────────
 
 std::string BrowseForFile(HWND hwnd, const char* filter, bool save) {
@@ -119,14 +125,23 @@ void DoConversion() {
         }
     }
 
+    auto token    = std::make_shared<CancelToken>();
+    g_cancelToken = token;
+
     converter.setConfig(cfg);
     converter.setProgressHandle(g_hProgress);
+    converter.setCancelToken(token.get());
+    SetDlgItemText(g_hMainWnd, ID_BTN_CONVERT, "CANCEL");
 
     std::thread([=]() mutable {
         bool ok = converter.convert(p1File, p2File, outFile);
         g_converting = false;
         SendMessage(g_hProgress, PBM_SETPOS, 0, 0);
-        if (ok)
+        SetDlgItemText(g_hMainWnd, ID_BTN_CONVERT, "CONVERT");
+        if (token->stopRequested())
+            MessageBox(g_hMainWnd, "Conversion cancelled. No output was written.", "Cancelled",
+                       MB_OK | MB_ICONINFORMATION);
+        else if (ok)
             MessageBox(g_hMainWnd, "Conversion completed successfully!", "Success",
                        MB_OK | MB_ICONINFORMATION);
         else
@@ -287,6 +302,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         guiLogger.logColored("Ready to convert!\n\n", GREEN);
         guiLogger.logColored("Optimizations active:\n", YELLOW);
         guiLogger.log("  - Parallel MIDI parsing\n");
+        guiLogger.log(std::string("  - SIMD skipping of controller data (") +
+                      CpuFeatures::name(CpuFeatures::active()) + ")\n");
         guiLogger.log("  - Smart decimal removal\n");
         guiLogger.log("  - Minify JSON (enabled by default)\n");
         guiLogger.log("  - Round times option\n");
@@ -315,8 +332,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             }
             case ID_BTN_CONVERT:
                 if (!g_converting) DoConversion();
-                else MessageBox(hwnd, "Conversion already in progress!", "Info",
-                                MB_OK | MB_ICONINFORMATION);
+                else if (g_cancelToken) {
+                    g_cancelToken->cancel();
+                    guiLogger.logColored("Cancelling...\n", YELLOW);
+                }
                 break;
             case ID_BTN_CLEAR_LOG:
                 SetWindowText(g_hConsole, "");
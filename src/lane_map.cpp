@@ -0,0 +1,87 @@
+#include "lane_map.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <initializer_list>
+
+// ─── Presets ──────────────────────────────────────────────────────────────────
+
+namespace {
+
+// General MIDI percussion (channel 10 note numbers) by kit piece.
+void drumPreset(std::array<int16_t, 128>& lanes) {
+    auto set = [&](std::initializer_list<int> pitches, int lane) {
+        for (int p : pitches) lanes[p] = static_cast<int16_t>(lane);
+    };
+    set({35, 36},                             0);   // kicks
+    set({37, 38, 39, 40},                     1);   // snares, rim, clap
+    set({42, 44, 46, 54, 56, 69, 70, 75},     2);   // hi-hats, small percussion
+    set({41, 43, 45, 47, 48, 50},             3);   // toms
+    set({49, 51, 52, 53, 55, 57, 59},         4);   // crashes and rides
+}
+
+// Non-negative integer at s[pos], advancing pos; -1 if none.
+int readInt(const std::string& s, size_t& pos) {
+    size_t start = pos;
+    while (pos < s.size() && std::isdigit(static_cast<unsigned char>(s[pos]))) ++pos;
+    if (pos == start || pos - start > 4) return -1;
+    return std::atoi(s.substr(start, pos - start).c_str());
+}
+
+} // namespace
+
+// ─── parse ────────────────────────────────────────────────────────────────────
+
+bool LaneMap::parse(const std::string& spec, LaneMap& out, std::string& error) {
+    LaneMap map;
+    if (spec.empty() || spec == "mod") {
+        out = map;
+        return true;
+    }
+
+    map.m_modulo = false;
+    map.m_lanes.fill(-1);
+    if (spec == "drums") {
+        drumPreset(map.m_lanes);
+        out = map;
+        return true;
+    }
+
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t itemStart = pos;
+        int lo = readInt(spec, pos), hi = lo;
+        if (lo >= 0 && pos < spec.size() && spec[pos] == '-') {
+            ++pos;
+            hi = readInt(spec, pos);
+        }
+        int lane = -1;
+        if (pos < spec.size() && spec[pos] == ':') {
+            ++pos;
+            lane = readInt(spec, pos);
+        }
+        if (lo < 0 || hi < lo || hi > 127 || lane < 0 || lane > 127 ||
+            (pos < spec.size() && spec[pos] != ',')) {
+            size_t comma = spec.find(',', itemStart);
+            error = "bad lane mapping \"" + spec.substr(itemStart, comma - itemStart) + "\"";
+            return false;
+        }
+        for (int p = lo; p <= hi; ++p) map.m_lanes[p] = static_cast<int16_t>(lane);
+        if (pos < spec.size()) ++pos;   // ','
+    }
+
+    out = map;
+    return true;
+}
+
+// ─── compile ──────────────────────────────────────────────────────────────────
+
+LaneMap::Table LaneMap::compile(int keyCount) const {
+    Table table;
+    const int keys = keyCount > 0 ? keyCount : 1;
+    for (int p = 0; p < 128; ++p) {
+        int lane = m_modulo ? p : m_lanes[p];
+        table[p] = lane < 0 ? kDrop : static_cast<int8_t>(lane % keys);
+    }
+    return table;
+}
@@ -1,17 +1,468 @@
 #include "psych_converter.h"
 #include "utils.h"
 
-#ifdef _WIN32
-
-#include <windows.h>
-#include <commctrl.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cctype>
+#include <cstdlib>
 
-#include "gui.h"
+#include "cancel_token.h"
+#include "cpu_features.h"
 #include "gui_logger.h"
 
+#ifdef _WIN32
+  #include <windows.h>
+  #include <commctrl.h>
+  #include "gui.h"
+#else
+  #include <csignal>
+#endif
+
+// ─── CLI list helpers ─────────────────────────────────────────────────────────
+
+static std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == std::string::npos) comma = s.size();
+        if (comma > start) items.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+// "0,2,Lead" → track indices {0,2} and track names {"Lead"}.
+static void parseTrackList(const std::string& s, MIDIFilter& f) {
+    for (const auto& item : splitList(s)) {
+        if (item.find_first_not_of("0123456789") == std::string::npos)
+            f.tracks.push_back(std::stoi(item));
+        else
+            f.trackNames.push_back(item);
+    }
+}
+
+// "1,2,10" (1-based MIDI channels) → bitmask.
+static uint16_t parseChannelList(const std::string& s) {
+    uint16_t mask = 0;
+    for (const auto& item : splitList(s)) {
+        int ch = std::stoi(item);
+        if (ch >= 1 && ch <= 16) mask |= static_cast<uint16_t>(1u << (ch - 1));
+    }
+    return mask;
+}
+
+// "36:59" → inclusive pitch range.
+static void parsePitchRange(const std::string& s, MIDIFilter& f) {
+    size_t sep = s.find(':');
+    int lo = std::stoi(s.substr(0, sep));
+    int hi = (sep == std::string::npos) ? lo : std::stoi(s.substr(sep + 1));
+    f.minPitch = static_cast<uint8_t>(std::max(0, std::min(lo, 127)));
+    f.maxPitch = static_cast<uint8_t>(std::max(0, std::min(hi, 127)));
+}
+
+// "512k", "2m" or plain bytes → byte count.
+static size_t parseByteSize(const std::string& s) {
+    double v = std::stod(s);
+    char unit = s.empty() ? '\0' : static_cast<char>(std::tolower(static_cast<unsigned char>(s.back())));
+    if (unit == 'k') v *= 1024.0;
+    if (unit == 'm') v *= 1024.0 * 1024.0;
+    if (unit == 'g') v *= 1024.0 * 1024.0 * 1024.0;
+    return static_cast<size_t>(std::max(0.0, v));
+}
+
+// "30000:60000" (ms) or "8b:16b" (bars, inclusive) → conversion range.
+static bool parseRange(const std::string& s, PsychConverter::Config& cfg) {
+    size_t sep = s.find(':');
+    if (sep == std::string::npos || sep == 0 || sep + 1 == s.size()) return false;
+    std::string lo = s.substr(0, sep), hi = s.substr(sep + 1);
+    bool loBars = lo.back() == 'b', hiBars = hi.back() == 'b';
+    if (loBars != hiBars) return false;
+    if (loBars) { lo.pop_back(); hi.pop_back(); }
+    cfg.useRange    = true;
+    cfg.rangeInBars = loBars;
+    cfg.rangeStart  = std::stod(lo);
+    cfg.rangeEnd    = std::stod(hi);
+    return loBars ? cfg.rangeEnd >= cfg.rangeStart : cfg.rangeEnd > cfg.rangeStart;
+}
+
+// "hard=song-hard.json,velocity=40,offset=-5" → base config with overrides.
+// Keys: velocity, offset, mania, speed, bpm, nps, gap.
+static bool parseDifficulty(const std::string& spec, const PsychConverter::Config& base,
+                            PsychConverter::Difficulty& d) {
+    auto items = splitList(spec);
+    if (items.empty()) return false;
+    size_t eq = items[0].find('=');
+    if (eq == std::string::npos || eq == 0 || eq + 1 == items[0].size()) return false;
+    d.name    = items[0].substr(0, eq);
+    d.outFile = items[0].substr(eq + 1);
+    d.config  = base;
+    for (size_t i = 1; i < items.size(); ++i) {
+        size_t sep = items[i].find('=');
+        if (sep == std::string::npos) return false;
+        std::string key = items[i].substr(0, sep), val = items[i].substr(sep + 1);
+        if      (key == "velocity") d.config.minVelocity   = std::stoi(val);
+        else if (key == "offset")   d.config.noteOffset    = std::stod(val);
+        else if (key == "mania")    d.config.mania         = std::stoi(val);
+        else if (key == "speed")    d.config.speed         = std::stod(val);
+        else if (key == "bpm")      d.config.bpmMultiplier = std::stod(val);
+        else if (key == "nps")      d.config.maxNPS        = std::stoi(val);
+        else if (key == "gap")      d.config.minLaneGapMs  = std::stod(val);
+        else return false;
+    }
+    return true;
+}
+
+// "extra.mid,player=2,offset=4,tracks=Lead+2,channels=1+2,pitch=36:47" →
+// one more input.  Its filter starts from that player's (global channel,
+// pitch and velocity options; not --p1/--p2-tracks).  Lists use '+'.
+static bool parseInput(const std::string& spec, const PsychConverter::Config& base,
+                       PsychConverter::Input& in) {
+    auto items = splitList(spec);
+    if (items.empty()) return false;
+    in.file = items[0];
+    std::vector<std::pair<std::string, std::string>> keys;
+    for (size_t i = 1; i < items.size(); ++i) {
+        size_t sep = items[i].find('=');
+        if (sep == std::string::npos) return false;
+        std::string val = items[i].substr(sep + 1);
+        std::replace(val.begin(), val.end(), '+', ',');
+        keys.emplace_back(items[i].substr(0, sep), val);
+        if (keys.back().first == "player") in.player = std::stoi(val);
+    }
+    if (in.player != 1 && in.player != 2) return false;
+
+    in.filter = in.player == 1 ? base.p1Filter : base.p2Filter;
+    in.filter.tracks.clear();
+    in.filter.trackNames.clear();
+    for (const auto& [key, val] : keys) {
+        if      (key == "player")   continue;
+        else if (key == "offset")   in.laneOffset = std::stoi(val);
+        else if (key == "tracks")   parseTrackList(val, in.filter);
+        else if (key == "channels") in.filter.channelMask &= parseChannelList(val);
+        else if (key == "pitch")    parsePitchRange(val, in.filter);
+        else return false;
+    }
+    return true;
+}
+
+// "b1.mid,b2.mid,gap=2b" → medley segment after the positional pair; the
+// gap is in ms, or bars at the segment's opening tempo with a 'b' suffix.
+static bool parseSegment(const std::string& spec, PsychConverter& converter,
+                         PsychConverter::MedleySegment& seg) {
+    auto items = splitList(spec);
+    if (items.size() < 2) return false;
+    seg.inputs = converter.playerInputs(items[0], items[1]);
+    for (size_t i = 2; i < items.size(); ++i) {
+        size_t sep = items[i].find('=');
+        if (sep == std::string::npos || items[i].substr(0, sep) != "gap") return false;
+        std::string val = items[i].substr(sep + 1);
+        if (val.empty()) return false;
+        seg.gapInBars = val.back() == 'b';
+        if (seg.gapInBars) val.pop_back();
+        seg.gap = std::stod(val);
+        if (seg.gap < 0.0) return false;
+    }
+    return true;
+}
+
+// Ctrl+C / console close stops the conversion cleanly instead of killing it
+// mid-write.
+static CancelToken g_cliCancel;
+
+#ifdef _WIN32
+static BOOL WINAPI ConsoleCtrlHandler(DWORD /*type*/) {
+    g_cliCancel.cancel();
+    return TRUE;
+}
+
+// The console is our own (AllocConsole): keep it open until a key press.
+static void pauseConsole() { system("pause"); }
+#else
+static void onSignal(int /*sig*/) { g_cliCancel.cancel(); }
+
+static void pauseConsole() {}
+#endif
+
+// ─── CLI ─────────────────────────────────────────────────────────────────────
+
+// args[0] is the program name.  Returns the process exit code.
+static int runCli(const std::vector<std::string>& args) {
+    int argc = static_cast<int>(args.size());
+
+    // Chart → MIDI: --to-midi <chart.json> <p1.mid> <p2.mid> [--ppq n]
+    if (argc > 1 && args[1] == "--to-midi") {
+        if (argc < 5) {
+            std::cout << RED "Error: --to-midi needs a chart and two output MIDI files!\n" RESET;
+            std::cout << "Usage: midi2psych --to-midi <chart.json> <p1.mid> <p2.mid> [--ppq n]\n";
+            pauseConsole();
+            return 1;
+        }
+        int ppq = 0;   // auto
+        for (int i = 5; i + 1 < argc; ++i)
+            if (args[i] == "--ppq") ppq = std::stoi(args[++i]);
+
+        PsychConverter converter;
+        converter.setCancelToken(&g_cliCancel);
+        bool ok = converter.exportMidi(args[2], args[3], args[4],
+                                       static_cast<uint16_t>(std::max(0, std::min(ppq, 32767))));
+        pauseConsole();
+        return ok ? 0 : 1;
+    }
+
+    // Chart ↔ binary chart: --transcode <in> <out> [output options]
+    const bool transcode = argc > 1 && args[1] == "--transcode";
+    if (transcode && argc < 4) {
+        std::cout << RED "Error: --transcode needs an input and an output chart!\n" RESET;
+        std::cout << "Usage: midi2psych --transcode <in> <out> [options]\n";
+        pauseConsole();
+        return 1;
+    }
+
+    if (argc < 3) {
+        std::cout << RED "Error: Need at least 2 MIDI files!\n" RESET;
+        std::cout << "Usage: midi2psych <p1.mid> <p2.mid> [output.json] [options]\n";
+        std::cout << "       midi2psych --to-midi <chart.json> <p1.mid> <p2.mid> [--ppq n]\n";
+        std::cout << "       midi2psych --transcode <in> <out> [options]   (JSON <-> binary)\n\n";
+        std::cout << "Options:\n"
+                  << "  -s / --song    <name>   Song name\n"
+                  << "  -b / --bpm     <mult>   BPM multiplier\n"
+                  << "  -o / --offset  <ms>     Note offset in ms\n"
+                  << "  -v / --velocity <n>     Min MIDI velocity\n"
+                  << "  -p / --precision <n>    Decimal places\n"
+                  << "  --speed        <n>      Chart scroll speed\n"
+                  << "  --mania        <n>      Key count (0=1-key, 2=3-key, 3=4-key(default), 4=5-key...)\n"
+                  << "  --lanes        <spec>   Pitch to lane map: mod, drums, or pitch:lane / lo-hi:lane list\n"
+                  << "  --p1 / --p2 / --gf / --stage  <name>\n"
+                  << "  --sustain               Enable sustain notes\n"
+                  << "  --sustain-overlap <trim|tap>  Fix sustains running into the lane's next note\n"
+                  << "  --sustain-gap  <ms>     Space to leave after a trimmed sustain\n"
+                  << "  --no-precision          Disable high precision\n"
+                  << "  --split        <n>      Split output (N notes/file)\n"
+                  << "  --minify                Minify JSON output\n"
+                  << "  --binary                Write a compact binary chart (.m2pc) instead of JSON\n"
+                  << "  --compress <codec>[:n]  Compress JSON output as it is written: gzip or zstd,\n"
+                  << "                          at level n (adds .gz / .zst to every file name)\n"
+                  << "  --round        <n>      Round timestamps (-1=off, 0=int, …)\n"
+                  << "  --shard-size   <n>[k|m] Sharded output + manifest, cut by JSON size\n"
+                  << "  --shard-ms     <ms>     Sharded output + manifest, cut by time span\n"
+                  << "  --max-memory   <n>[kmg] Memory budget (serial parse, streamed JSON, else fail)\n"
+                  << "  --legacy-timing         Floating-point timing of older versions\n"
+                  << "  --cpu-features <level>  Cap SIMD kernels: auto, scalar, sse2, avx2, avx512\n"
+                  << "  --dedup        <ms>     Merge same-lane notes starting within ms (0 = same time)\n"
+                  << "  --max-nps      <n>      Thin notes to at most N per second (lowest velocity first)\n"
+                  << "  --nps-window   <ms>     Sliding window for --max-nps (default 1000)\n"
+                  << "  --min-gap      <ms>     Minimum time between notes in one lane\n"
+                  << "  --p1-tracks / --p2-tracks <list>  Tracks to read (indices or names)\n"
+                  << "  --channels     <list>   Keep only these MIDI channels (1-16)\n"
+                  << "  --skip-channels <list>  Drop these MIDI channels (e.g. 10 = drums)\n"
+                  << "  --pitch        <lo:hi>  Keep only notes in this pitch range\n"
+                  << "  --max-velocity <n>      Max MIDI velocity\n"
+                  << "  --full                  Reconvert notes even if only song metadata changed\n"
+                  << "  --watch                 Re-convert whenever an input MIDI is saved\n"
+                  << "  --timeout      <sec>    Give up (writing nothing) after this long\n"
+                  << "  --range        <a:b>    Only notes from a to b ms, or bars with 'b' (e.g. 8b:16b)\n"
+                  << "  --patch                 Re-convert only --range into the existing output chart\n"
+                  << "  --input <file>[,key=value…]  Extra MIDI input, parsed alongside the two\n"
+                  << "                          (keys: player=1|2, offset, tracks, channels, pitch;\n"
+                  << "                          lists joined with '+'; repeatable)\n"
+                  << "  --segment <p1.mid>,<p2.mid>[,gap=<ms>|<n>b]  Medley: append another song\n"
+                  << "                          after the positional pair (repeatable, in order)\n"
+                  << "  --difficulty <name>=<out.json>[,key=value…]  Extra chart from the same parse\n"
+                  << "                          (keys: velocity, offset, mania, speed, bpm, nps, gap; repeatable)\n";
+        pauseConsole();
+        return 1;
+    }
+
+    const int   first   = transcode ? 2 : 1;   // first positional argument
+    std::string p1File  = args[first];
+    std::string p2File  = args[first + 1];
+    std::string outFile = (argc > 3 && args[3][0] != '-') ? args[3] : "chart.json";
+
+    PsychConverter converter;
+    auto& cfg = converter.getConfig();
+    std::vector<std::string> difficultySpecs;
+    std::vector<std::string> inputSpecs;
+    std::vector<std::string> segmentSpecs;
+    bool watchMode = false;
+    bool patchMode = false;
+
+    for (int i = first + 2; i < argc; ++i) {
+        const std::string& a = args[i];
+        auto next = [&]() -> const std::string& { return args[++i]; };
+
+        if      ((a == "-s"  || a == "--song")      && i+1 < argc) cfg.songName      = next();
+        else if ((a == "-b"  || a == "--bpm")       && i+1 < argc) cfg.bpmMultiplier = std::stod(next());
+        else if ((a == "-o"  || a == "--offset")    && i+1 < argc) cfg.noteOffset    = std::stod(next());
+        else if ((a == "-v"  || a == "--velocity")  && i+1 < argc) cfg.minVelocity   = std::stoi(next());
+        else if ((a == "-p"  || a == "--precision") && i+1 < argc) cfg.decimalPlaces = std::stoi(next());
+        else if ( a == "--speed"   && i+1 < argc)                  cfg.speed         = std::stod(next());
+        else if ( a == "--mania"   && i+1 < argc)                  cfg.mania         = std::stoi(next());
+        else if ( a == "--p1"      && i+1 < argc)                  cfg.p1Char        = next();
+        else if ( a == "--p2"      && i+1 < argc)                  cfg.p2Char        = next();
+        else if ( a == "--gf"      && i+1 < argc)                  cfg.gfChar        = next();
+        else if ( a == "--stage"   && i+1 < argc)                  cfg.stage         = next();
+        else if ( a == "--split"   && i+1 < argc) { cfg.splitOutput = true;  cfg.notesPerSplit = std::stoi(next()); }
+        else if ( a == "--round"   && i+1 < argc)                  cfg.roundTimesTo  = std::stoi(next());
+        else if ( a == "--shard-size" && i+1 < argc)               cfg.shardBytes    = parseByteSize(next());
+        else if ( a == "--shard-ms"   && i+1 < argc)               cfg.shardMs       = std::stod(next());
+        else if ( a == "--max-memory" && i+1 < argc)               cfg.maxMemoryBytes = parseByteSize(next());
+        else if ( a == "--sustain")                                 cfg.sustainNotes  = true;
+        else if ( a == "--sustain-overlap" && i+1 < argc) {
+            const std::string& mode = next();
+            cfg.sustainOverlap = mode == "trim" ? 1 : mode == "tap" ? 2 : 0;
+        }
+        else if ( a == "--sustain-gap" && i+1 < argc)              cfg.sustainGapMs  = std::stod(next());
+        else if ( a == "--minify")                                  cfg.minifyJSON    = true;
+        else if ( a == "--binary")                                  cfg.binaryOutput  = true;
+        else if ( a == "--no-precision")                            cfg.highPrecision = false;
+        else if ( a == "--legacy-timing")                           cfg.legacyTiming  = true;
+        else if ( a == "--dedup"      && i+1 < argc)               cfg.dedupMs       = std::stod(next());
+        else if ( a == "--max-nps"    && i+1 < argc)               cfg.maxNPS        = std::stoi(next());
+        else if ( a == "--nps-window" && i+1 < argc)               cfg.npsWindowMs   = std::stod(next());
+        else if ( a == "--min-gap"    && i+1 < argc)               cfg.minLaneGapMs  = std::stod(next());
+        else if ( a == "--full")                                    cfg.reuseOutput   = false;
+        else if ( a == "--watch")                                   watchMode         = true;
+        else if ( a == "--patch")                                   patchMode         = true;
+        else if ( a == "--timeout" && i+1 < argc)
+            g_cliCancel.setTimeout(std::chrono::milliseconds(
+                static_cast<long long>(std::stod(next()) * 1000.0)));
+        else if ( a == "--p1-tracks" && i+1 < argc)                parseTrackList(next(), cfg.p1Filter);
+        else if ( a == "--p2-tracks" && i+1 < argc)                parseTrackList(next(), cfg.p2Filter);
+        else if ( a == "--channels"  && i+1 < argc) {
+            uint16_t mask = parseChannelList(next());
+            cfg.p1Filter.channelMask &= mask;
+            cfg.p2Filter.channelMask &= mask;
+        }
+        else if ( a == "--skip-channels" && i+1 < argc) {
+            uint16_t mask = parseChannelList(next());
+            cfg.p1Filter.channelMask &= static_cast<uint16_t>(~mask);
+            cfg.p2Filter.channelMask &= static_cast<uint16_t>(~mask);
+        }
+        else if ( a == "--pitch" && i+1 < argc) {
+            parsePitchRange(next(), cfg.p1Filter);
+            cfg.p2Filter.minPitch = cfg.p1Filter.minPitch;
+            cfg.p2Filter.maxPitch = cfg.p1Filter.maxPitch;
+        }
+        else if ( a == "--max-velocity" && i+1 < argc) {
+            int v = std::max(0, std::min(std::stoi(next()), 127));
+            cfg.p1Filter.maxVelocity = cfg.p2Filter.maxVelocity = static_cast<uint8_t>(v);
+        }
+        else if ( a == "--difficulty" && i+1 < argc)               difficultySpecs.push_back(next());
+        else if ( a == "--input"      && i+1 < argc)               inputSpecs.push_back(next());
+        else if ( a == "--segment"    && i+1 < argc)               segmentSpecs.push_back(next());
+        else if ( a == "--lanes" && i+1 < argc) {
+            std::string error;
+            if (!LaneMap::parse(next(), cfg.laneMap, error)) {
+                std::cout << "Invalid --lanes: " << error << "\n";
+                pauseConsole();
+                return 1;
+            }
+        }
+        else if ( a == "--compress" && i+1 < argc) {
+            std::string error;
+            if (!StreamCompressor::parse(next(), cfg.compression, cfg.compressionLevel, error)) {
+                std::cout << "Invalid --compress: " << error << "\n";
+                pauseConsole();
+                return 1;
+            }
+        }
+        else if ( a == "--cpu-features" && i+1 < argc) {
+            std::string error;
+            if (!CpuFeatures::limit(next(), error)) {
+                std::cout << "Invalid --cpu-features: " << error << "\n";
+                pauseConsole();
+                return 1;
+            }
+        }
+        else if ( a == "--range" && i+1 < argc) {
+            if (!parseRange(next(), cfg)) {
+                std::cout << "Invalid --range: " << args[i] << "\n";
+                pauseConsole();
+                return 1;
+            }
+        }
+    }
+
+    if (cfg.binaryOutput && cfg.compression != StreamCompressor::kNone) {
+        std::cout << "--compress applies to JSON output, not --binary\n";
+        pauseConsole();
+        return 1;
+    }
+
+    converter.setConfig(cfg);
+    converter.setCancelToken(&g_cliCancel);
+#ifdef _WIN32
+    SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+#else
+    std::signal(SIGINT,  onSignal);
+    std::signal(SIGTERM, onSignal);
+#endif
+
+    // Extra inputs go after the two positional ones, whatever their order
+    // among the other options.
+    std::vector<PsychConverter::Input> inputs = converter.playerInputs(p1File, p2File);
+    for (const auto& spec : inputSpecs) {
+        PsychConverter::Input in;
+        if (!parseInput(spec, converter.getConfig(), in)) {
+            std::cout << "Invalid --input: " << spec << "\n";
+            pauseConsole();
+            return 1;
+        }
+        inputs.push_back(std::move(in));
+    }
+
+    bool ok;
+    if (transcode) {
+        ok = converter.transcode(p1File, p2File);
+    } else if (!segmentSpecs.empty()) {
+        if (watchMode || patchMode || !difficultySpecs.empty()) {
+            std::cout << "--segment can't be combined with --watch, --patch or --difficulty\n";
+            pauseConsole();
+            return 1;
+        }
+        // The positional pair (with any --input) opens the medley.
+        std::vector<PsychConverter::MedleySegment> segments(1);
+        segments[0].inputs = inputs;
+        for (const auto& spec : segmentSpecs) {
+            PsychConverter::MedleySegment seg;
+            if (!parseSegment(spec, converter, seg)) {
+                std::cout << "Invalid --segment: " << spec << "\n";
+                pauseConsole();
+                return 1;
+            }
+            segments.push_back(std::move(seg));
+        }
+        ok = converter.convertMedley(segments, outFile);
+    } else if (watchMode) {
+        ok = converter.watch(inputs, outFile);
+    } else if (patchMode) {
+        ok = converter.patchRange(inputs, outFile);
+    } else if (difficultySpecs.empty()) {
+        ok = converter.convert(inputs, outFile);
+    } else {
+        // Profiles apply on top of every other option, whatever their order.
+        std::vector<PsychConverter::Difficulty> difficulties;
+        ok = true;
+        for (const auto& spec : difficultySpecs) {
+            PsychConverter::Difficulty d;
+            if (!parseDifficulty(spec, converter.getConfig(), d)) {
+                std::cout << "Invalid --difficulty: " << spec << "\n";
+                ok = false;
+                break;
+            }
+            difficulties.push_back(std::move(d));
+        }
+        if (ok) ok = converter.convertDifficulties(inputs, difficulties);
+    }
+    pauseConsole();
+    return ok ? 0 : 1;
+}
+
+#ifdef _WIN32
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/,
                    LPSTR /*lpCmdLine*/, int nCmdShow) {
     int     argc;
@@ -35,61 +486,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/,
             args.push_back(std::move(s));
         }
         LocalFree(argv);
-
-        if (argc < 3) {
-            std::cout << RED "Error: Need at least 2 MIDI files!\n" RESET;
-            std::cout << "Usage: converter.exe <p1.mid> <p2.mid> [output.json] [options]\n\n";
-            std::cout << "Options:\n"
-                      << "  -s / --song    <name>   Song name\n"
-                      << "  -b / --bpm     <mult>   BPM multiplier\n"
-                      << "  -o / --offset  <ms>     Note offset in ms\n"
-                      << "  -v / --velocity <n>     Min MIDI velocity\n"
-                      << "  -p / --precision <n>    Decimal places\n"
-                      << "  --speed        <n>      Chart scroll speed\n"
-                      << "  --mania        <n>      Key count (0=1-key, 2=3-key, 3=4-key(default), 4=5-key...)\n"
-                      << "  --p1 / --p2 / --gf / --stage  <name>\n"
-                      << "  --sustain               Enable sustain notes\n"
-                      << "  --no-precision          Disable high precision\n"
-                      << "  --split        <n>      Split output (N notes/file)\n"
-                      << "  --minify                Minify JSON output\n"
-                      << "  --round        <n>      Round timestamps (-1=off, 0=int, …)\n";
-            system("pause");
-            return 1;
-        }
-
-        std::string p1File  = args[1];
-        std::string p2File  = args[2];
-        std::string outFile = (argc > 3 && args[3][0] != '-') ? args[3] : "chart.json";
-
-        PsychConverter converter;
-        auto& cfg = converter.getConfig();
-
-        for (int i = 3; i < argc; ++i) {
-            const std::string& a = args[i];
-            auto next = [&]() -> const std::string& { return args[++i]; };
-
-            if      ((a == "-s"  || a == "--song")      && i+1 < argc) cfg.songName      = next();
-            else if ((a == "-b"  || a == "--bpm")       && i+1 < argc) cfg.bpmMultiplier = std::stod(next());
-            else if ((a == "-o"  || a == "--offset")    && i+1 < argc) cfg.noteOffset    = std::stod(next());
-            else if ((a == "-v"  || a == "--velocity")  && i+1 < argc) cfg.minVelocity   = std::stoi(next());
-            else if ((a == "-p"  || a == "--precision") && i+1 < argc) cfg.decimalPlaces = std::stoi(next());
-            else if ( a == "--speed"   && i+1 < argc)                  cfg.speed         = std::stod(next());
-            else if ( a == "--mania"   && i+1 < argc)                  cfg.mania         = std::stoi(next());
-            else if ( a == "--p1"      && i+1 < argc)                  cfg.p1Char        = next();
-            else if ( a == "--p2"      && i+1 < argc)                  cfg.p2Char        = next();
-            else if ( a == "--gf"      && i+1 < argc)                  cfg.gfChar        = next();
-            else if ( a == "--stage"   && i+1 < argc)                  cfg.stage         = next();
-            else if ( a == "--split"   && i+1 < argc) { cfg.splitOutput = true;  cfg.notesPerSplit = std::stoi(next()); }
-            else if ( a == "--round"   && i+1 < argc)                  cfg.roundTimesTo  = std::stoi(next());
-            else if ( a == "--sustain")                                 cfg.sustainNotes  = true;
-            else if ( a == "--minify")                                  cfg.minifyJSON    = true;
-            else if ( a == "--no-precision")                            cfg.highPrecision = false;
-        }
-
-        converter.setConfig(cfg);
-        bool ok = converter.convert(p1File, p2File, outFile);
-        system("pause");
-        return ok ? 0 : 1;
+        return runCli(args);
     }
 
     LocalFree(argv);
@@ -129,12 +526,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/,
 
 #else
 
-// ── Non-Windows CLI stub ──────────────────────────────────────────────────────
-#include <iostream>
-
-int main(int /*argc*/, char* /*argv*/[]) {
-    std::cout << "GUI mode is Windows-only. CLI support can be added here.\n";
-    return 0;
+int main(int argc, char* argv[]) {
+    return runCli(std::vector<std::string>(argv, argv + argc));
 }
 
 #endif
@@ -1,18 +1,280 @@
 #include "midi_parser.h"
 
+#include <algorithm>
+#include <cctype>
 #include <fstream>
-#include <map>
+#include <sstream>
+
+#include "cancel_token.h"
+#include "cpu_features.h"
 
 // ─── Private helpers ──────────────────────────────────────────────────────────
 
-uint32_t MIDIParser::readVarLen() {
-    uint32_t val = 0;
-    uint8_t  byte;
-    do {
-        byte = m_data[m_pos++];
-        val  = (val << 7) | (byte & 0x7f);
-    } while (byte & 0x80);
-    return val;
+// Checked VLQ read; SMF caps variable-length quantities at 4 bytes.  One- and
+// two-byte values (nearly every delta-time) take straight-line paths; longer
+// ones find their terminator with one bitmask instead of a loop.
+static inline bool readVarLenChecked(const uint8_t*& p, const uint8_t* end, uint32_t& val) {
+    if (p < end && *p < 0x80) {
+        val = *p++;
+        return true;
+    }
+    if (end - p >= 2 && p[1] < 0x80) {
+        val = (p[0] & 0x7fu) << 7 | p[1];
+        p  += 2;
+        return true;
+    }
+    if (end - p >= 4) {
+        uint32_t w = static_cast<uint32_t>(p[0])       | static_cast<uint32_t>(p[1]) << 8 |
+                     static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+        uint32_t stop = ~w & 0x80808080u;
+        if (!stop) return false;
+        unsigned len = (static_cast<unsigned>(__builtin_ctz(stop)) >> 3) + 1;
+
+        // Pack all four 7-bit groups big-endian, then shift off the unused tail.
+        uint32_t all = (w & 0x7f) << 21 | (w >> 8 & 0x7f) << 14 |
+                       (w >> 16 & 0x7f) << 7 | (w >> 24 & 0x7f);
+        val = all >> (7 * (4 - len));
+        p  += len;
+        return true;
+    }
+
+    val = 0;
+    for (int i = 0; i < 4 && p < end; ++i) {
+        uint8_t byte = *p++;
+        val = (val << 7) | (byte & 0x7f);
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// ─── Status dispatch table ────────────────────────────────────────────────────
+
+enum EventClass : uint8_t {
+    kNoStatus,      // data byte with no running status to fall back on
+    kNoteEvent,     // 0x8n / 0x9n
+    kChannel1,      // 0xCn / 0xDn – one data byte
+    kChannel2,      // 0xAn / 0xBn / 0xEn – two data bytes
+    kMetaEvent,     // 0xFF
+    kSysexEvent,    // 0xF0 / 0xF7
+    kSystemEvent    // other 0xFn – not valid inside a track chunk
+};
+
+struct StatusTable {
+    EventClass cls[256];
+    uint8_t    dataLen[256];
+};
+
+static constexpr StatusTable makeStatusTable() {
+    StatusTable t{};
+    for (int s = 0; s < 256; ++s) {
+        int type = s & 0xf0;
+        if      (s < 0x80)                      t.cls[s] = kNoStatus;
+        else if (type == 0x80 || type == 0x90)  t.cls[s] = kNoteEvent;
+        else if (type == 0xc0 || type == 0xd0)  t.cls[s] = kChannel1;
+        else if (type < 0xf0)                   t.cls[s] = kChannel2;
+        else if (s == 0xff)                     t.cls[s] = kMetaEvent;
+        else if (s == 0xf0 || s == 0xf7)        t.cls[s] = kSysexEvent;
+        else                                    t.cls[s] = kSystemEvent;
+
+        t.dataLen[s] = t.cls[s] == kChannel1 ? 1
+                     : (t.cls[s] == kChannel2 || t.cls[s] == kNoteEvent) ? 2 : 0;
+    }
+    return t;
+}
+
+static constexpr StatusTable kStatusTable = makeStatusTable();
+
+// ─── Controller-run skipping ──────────────────────────────────────────────────
+//
+// CC / pitch-bend / aftertouch data dominates controller-heavy MIDIs and is
+// never indexed.  Once the scan is inside such a run, whole vector windows are
+// matched against the three layouts that cover almost all of it:
+//   explicit status  [delta][An|Bn|En][d1][d2] × N
+//   running status   [delta][d1][d2] × N   (two-data-byte status)
+//   running status   [delta][d1] × N       (one-data-byte status)
+// with every delta a single byte.  A window that matches is provably a
+// sequence of complete, in-bounds events, so it is skipped after summing its
+// deltas; anything else falls back to the scalar loop.
+
+// One kernel per ISA level, each compiled for its target whatever the build
+// flags; parse() picks the one for CpuFeatures::active().  A kernel skips as
+// many whole windows as match and returns the bytes skipped (0 = none).  Wide
+// kernels finish a run with narrower windows, so they never skip less.
+
+static size_t skipRunScalar(const uint8_t*, const uint8_t*, uint32_t&, uint8_t&) { return 0; }
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+#define M2P_X86_KERNELS 1
+
+// Deltas sit at every 4th / 3rd / 2nd byte of the three layouts.  Narrower
+// windows use a prefix of the 4- and 2-byte tables; the 3-byte layout ends
+// differently in each width.
+alignas(64) static const uint8_t kDeltaLanes4[64] = {
+    0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0,
+    0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0, 0xff,0,0,0 };
+alignas(64) static const uint8_t kDeltaLanes2[64] = {
+    0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0,
+    0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0,
+    0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0,
+    0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0, 0xff,0 };
+alignas(16) static const uint8_t kDeltaLanes3x16[16] = {
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0 };
+alignas(32) static const uint8_t kDeltaLanes3x32[32] = {
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0,
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0,0 };
+alignas(64) static const uint8_t kDeltaLanes3x64[64] = {
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0,
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0,
+    0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0xff,0,0, 0 };
+
+// ── SSE2: 16-byte windows ──
+
+__attribute__((target("sse2")))
+static inline uint32_t sumDeltas(__m128i v, const uint8_t* lanes) {
+    __m128i d = _mm_and_si128(v, _mm_load_si128(reinterpret_cast<const __m128i*>(lanes)));
+    __m128i s = _mm_sad_epu8(d, _mm_setzero_si128());
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4));
+}
+
+__attribute__((target("sse2")))
+static inline const uint8_t* skipWindows16(const uint8_t* p, const uint8_t* e, uint32_t& time,
+                                           uint8_t& runningStatus) {
+    while (e - p >= 16) {
+        __m128i  v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t hi = static_cast<uint32_t>(_mm_movemask_epi8(v));
+
+        if (hi == 0x2222u) {
+            __m128i t  = _mm_and_si128(v, _mm_set1_epi8(static_cast<char>(0xf0)));
+            __m128i ok = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(t, _mm_set1_epi8(static_cast<char>(0xa0))),
+                             _mm_cmpeq_epi8(t, _mm_set1_epi8(static_cast<char>(0xb0)))),
+                _mm_cmpeq_epi8(t, _mm_set1_epi8(static_cast<char>(0xe0))));
+            if ((static_cast<uint32_t>(_mm_movemask_epi8(ok)) & 0x2222u) != 0x2222u)
+                break;
+            time         += sumDeltas(v, kDeltaLanes4);
+            runningStatus = p[13];
+            p += 16;
+        } else if (hi == 0 && kStatusTable.cls[runningStatus] == kChannel1) {
+            time += sumDeltas(v, kDeltaLanes2);
+            p += 16;
+        } else if ((hi & 0x7fffu) == 0 && kStatusTable.cls[runningStatus] == kChannel2) {
+            time += sumDeltas(v, kDeltaLanes3x16);
+            p += 15;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+__attribute__((target("sse2")))
+static size_t skipRunSSE2(const uint8_t* p, const uint8_t* e, uint32_t& time, uint8_t& runningStatus) {
+    return static_cast<size_t>(skipWindows16(p, e, time, runningStatus) - p);
+}
+
+// ── AVX2: 32-byte windows ──
+
+__attribute__((target("avx2")))
+static inline uint32_t sumDeltas(__m256i v, const uint8_t* lanes) {
+    __m256i d = _mm256_and_si256(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes)));
+    __m256i s = _mm256_sad_epu8(d, _mm256_setzero_si256());
+    return static_cast<uint32_t>(_mm256_extract_epi64(s, 0) + _mm256_extract_epi64(s, 1) +
+                                 _mm256_extract_epi64(s, 2) + _mm256_extract_epi64(s, 3));
+}
+
+__attribute__((target("avx2")))
+static inline const uint8_t* skipWindows32(const uint8_t* p, const uint8_t* e, uint32_t& time,
+                                           uint8_t& runningStatus) {
+    while (e - p >= 32) {
+        __m256i  v  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+
+        if (hi == 0x22222222u) {
+            __m256i t  = _mm256_and_si256(v, _mm256_set1_epi8(static_cast<char>(0xf0)));
+            __m256i ok = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(t, _mm256_set1_epi8(static_cast<char>(0xa0))),
+                                _mm256_cmpeq_epi8(t, _mm256_set1_epi8(static_cast<char>(0xb0)))),
+                _mm256_cmpeq_epi8(t, _mm256_set1_epi8(static_cast<char>(0xe0))));
+            if ((static_cast<uint32_t>(_mm256_movemask_epi8(ok)) & 0x22222222u) != 0x22222222u)
+                break;
+            time         += sumDeltas(v, kDeltaLanes4);
+            runningStatus = p[29];
+            p += 32;
+        } else if (hi == 0 && kStatusTable.cls[runningStatus] == kChannel1) {
+            time += sumDeltas(v, kDeltaLanes2);
+            p += 32;
+        } else if ((hi & 0x3fffffffu) == 0 && kStatusTable.cls[runningStatus] == kChannel2) {
+            time += sumDeltas(v, kDeltaLanes3x32);
+            p += 30;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+__attribute__((target("avx2")))
+static size_t skipRunAVX2(const uint8_t* p, const uint8_t* e, uint32_t& time, uint8_t& runningStatus) {
+    const uint8_t* q = skipWindows32(p, e, time, runningStatus);
+    return static_cast<size_t>(skipWindows16(q, e, time, runningStatus) - p);
+}
+
+// ── AVX-512 (F + BW): 64-byte windows, compares straight into masks ──
+
+__attribute__((target("avx512f,avx512bw")))
+static inline uint32_t sumDeltas(__m512i v, const uint8_t* lanes) {
+    __m512i d = _mm512_and_si512(v, _mm512_load_si512(lanes));
+    alignas(64) uint64_t s[8];
+    _mm512_store_si512(s, _mm512_sad_epu8(d, _mm512_setzero_si512()));
+    return static_cast<uint32_t>(s[0] + s[1] + s[2] + s[3] + s[4] + s[5] + s[6] + s[7]);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t skipRunAVX512(const uint8_t* p, const uint8_t* e, uint32_t& time, uint8_t& runningStatus) {
+    constexpr uint64_t kStatus4 = 0x2222222222222222ull;
+    const uint8_t* q = p;
+    while (e - q >= 64) {
+        __m512i  v  = _mm512_loadu_si512(q);
+        uint64_t hi = _mm512_movepi8_mask(v);
+
+        if (hi == kStatus4) {
+            __m512i   t  = _mm512_and_si512(v, _mm512_set1_epi8(static_cast<char>(0xf0)));
+            __mmask64 ok = _mm512_cmpeq_epi8_mask(t, _mm512_set1_epi8(static_cast<char>(0xa0))) |
+                           _mm512_cmpeq_epi8_mask(t, _mm512_set1_epi8(static_cast<char>(0xb0))) |
+                           _mm512_cmpeq_epi8_mask(t, _mm512_set1_epi8(static_cast<char>(0xe0)));
+            if ((ok & kStatus4) != kStatus4)
+                break;
+            time         += sumDeltas(v, kDeltaLanes4);
+            runningStatus = q[61];
+            q += 64;
+        } else if (hi == 0 && kStatusTable.cls[runningStatus] == kChannel1) {
+            time += sumDeltas(v, kDeltaLanes2);
+            q += 64;
+        } else if ((hi & 0x7fffffffffffffffull) == 0 && kStatusTable.cls[runningStatus] == kChannel2) {
+            time += sumDeltas(v, kDeltaLanes3x64);
+            q += 63;
+        } else {
+            break;
+        }
+    }
+    q = skipWindows32(q, e, time, runningStatus);
+    return static_cast<size_t>(skipWindows16(q, e, time, runningStatus) - p);
+}
+
+#endif
+
+static MIDIParser::RunSkipper selectRunSkipper() {
+    switch (CpuFeatures::active()) {
+#ifdef M2P_X86_KERNELS
+        case CpuFeatures::kAVX512: return skipRunAVX512;
+        case CpuFeatures::kAVX2:   return skipRunAVX2;
+        case CpuFeatures::kSSE2:   return skipRunSSE2;
+#endif
+        default:                   return skipRunScalar;
+    }
 }
 
 uint16_t MIDIParser::read16() {
@@ -28,110 +290,352 @@ uint32_t MIDIParser::read32() {
     return val;
 }
 
+bool MIDIParser::fail(size_t offset, const char* reason) {
+    std::ostringstream ss;
+    ss << "offset 0x" << std::hex << std::uppercase << offset << ": " << reason;
+    errorMessage = ss.str();
+    return false;
+}
+
+bool MIDIParser::stopped() {
+    if (!cancelToken || !cancelToken->stopRequested()) return false;
+    errorMessage = cancelToken->reason();
+    return true;
+}
+
+// ─── validateEvents ───────────────────────────────────────────────────────────
+
+bool MIDIParser::validateEvents(ScanCursor& cur, size_t end) {
+    const uint8_t* base = m_data.data();
+    const uint8_t* p    = base + cur.pos;
+    const uint8_t* e    = base + end;
+    uint32_t time          = cur.tick;
+    uint8_t  runningStatus = cur.runningStatus;
+
+    // Fixed-size batch written through a raw cursor: no capacity checks or
+    // reallocation paths in the scan loop.
+    m_index.resize(kIndexBatch);
+    IndexedEvent*       out    = m_index.data();
+    IndexedEvent* const outEnd = out + kIndexBatch;
+
+    while (p < e && out != outEnd) {
+        const uint8_t* evt = p;
+        uint32_t       val;
+        if (!readVarLenChecked(p, e, val))
+            return fail(evt - base, "truncated or over-long delta-time");
+        if (p >= e)
+            return fail(p - base, "delta-time without event at end of track");
+        time += val;
+
+        uint8_t status = *p;
+        if (status & 0x80) ++p;
+        else               status = runningStatus;
+
+        EventClass cls = kStatusTable.cls[status];
+        if (cls == kNoteEvent) {
+            runningStatus = status;
+            if (e - p < 2)
+                return fail(evt - base, "channel event overruns track chunk");
+            // Always written; only kept (cursor advanced) for wanted channels.
+            *out = {time, static_cast<uint32_t>(p - base), static_cast<uint8_t>(status & 0xf0)};
+            out += (m_channelMask >> (status & 0x0f)) & 1;
+            p   += 2;
+        } else if (cls == kChannel1 || cls == kChannel2) {
+            runningStatus = status;
+            if (e - p < kStatusTable.dataLen[status])
+                return fail(evt - base, "channel event overruns track chunk");
+            p += kStatusTable.dataLen[status];
+
+            p += m_skipRun(p, e, time, runningStatus);
+        } else if (cls == kMetaEvent) {
+            if (p >= e)
+                return fail(evt - base, "meta event overruns track chunk");
+            uint8_t metaType = *p++;
+            if (!readVarLenChecked(p, e, val))
+                return fail(evt - base, "truncated or over-long meta event length");
+            if (val > static_cast<size_t>(e - p))
+                return fail(evt - base, "meta event overruns track chunk");
+            if (metaType == 0x51 && val == 3) {
+                if ((p[0] | p[1] | p[2]) == 0)
+                    return fail(evt - base, "zero tempo");
+                *out++ = {time, static_cast<uint32_t>(p - base), 0xff};
+            }
+            p += val;
+        } else if (cls == kSysexEvent) {
+            if (!readVarLenChecked(p, e, val))
+                return fail(evt - base, "truncated or over-long sysex length");
+            if (val > static_cast<size_t>(e - p))
+                return fail(evt - base, "sysex event overruns track chunk");
+            p += val;
+        } else if (cls == kNoStatus) {
+            return fail(p - base, "data byte without running status");
+        } else {
+            return fail(evt - base, "system message not allowed in a track chunk");
+        }
+    }
+
+    m_indexCount      = static_cast<size_t>(out - m_index.data());
+    cur.pos           = static_cast<size_t>(p - base);
+    cur.tick          = time;
+    cur.runningStatus = runningStatus;
+    return true;
+}
+
+// ─── readTrackName ────────────────────────────────────────────────────────────
+
+std::string MIDIParser::readTrackName(size_t begin, size_t end) const {
+    const uint8_t* p = m_data.data() + begin;
+    const uint8_t* e = m_data.data() + end;
+
+    // Names live among the leading meta events; stop at the first other event.
+    while (p < e) {
+        uint32_t val;
+        if (!readVarLenChecked(p, e, val) || e - p < 2 || p[0] != 0xff)
+            break;
+        uint8_t metaType = p[1];
+        p += 2;
+        if (!readVarLenChecked(p, e, val) || val > static_cast<size_t>(e - p))
+            break;
+        if (metaType == 0x03)
+            return std::string(reinterpret_cast<const char*>(p), val);
+        p += val;
+    }
+    return "";
+}
+
+// ─── wantTrack ────────────────────────────────────────────────────────────────
+
+bool MIDIParser::wantTrack(uint16_t index, size_t begin, size_t end,
+                           const MIDIFilter& filter) const {
+    if (!filter.selectsTracks()) return true;
+
+    for (int t : filter.tracks)
+        if (t == index) return true;
+
+    if (!filter.trackNames.empty()) {
+        auto lower = [](std::string s) {
+            for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            return s;
+        };
+        std::string name = lower(readTrackName(begin, end));
+        for (const auto& n : filter.trackNames)
+            if (!name.empty() && lower(n) == name) return true;
+    }
+    return false;
+}
+
+// ─── parseTrack ───────────────────────────────────────────────────────────────
+
+bool MIDIParser::parseTrack(size_t begin, size_t end, bool sustainNotes,
+                            const MIDIFilter& filter, SeekIndex::Track* seek) {
+    std::vector<MIDINote> events;
+    events.reserve(m_channelMask ? 10000 : 0);
+
+    struct ActiveNote { uint32_t tick; uint8_t vel; bool on; };
+    ActiveNote activeNotes[128] = {};
+
+    const uint8_t  minVel   = filter.minVelocity, maxVel   = filter.maxVelocity;
+    const uint8_t  minPitch = filter.minPitch,    maxPitch = filter.maxPitch;
+    const uint32_t winStart = filter.startTick;
+    const uint32_t winSpan  = filter.endTick - filter.startTick;   // tick - winStart < winSpan
+    const uint8_t* base     = m_data.data();
+    ScanCursor     cur{begin, 0, 0};
+
+    const bool record = seek && !m_useSeekIndex;
+
+    // Resume at the last seek point strictly before the window: events
+    // skipped all start before it, so none can be kept.  Notes sounding
+    // across the point started before the window too.
+    if (seek && m_useSeekIndex && seek->seekable && winStart > 0) {
+        const auto& pts = seek->points;
+        auto it = std::lower_bound(pts.begin(), pts.end(), winStart,
+            [](const SeekPoint& sp, uint32_t t) { return sp.tick < t; });
+        if (it != pts.begin()) {
+            --it;
+            if (it->pos > begin && it->pos < end)
+                cur = {it->pos, it->tick, it->runningStatus};
+        }
+    }
+
+    while (cur.pos < end) {
+        if (stopped() || !validateEvents(cur, end))
+            return false;
+        if (record && cur.pos < end)
+            seek->points.push_back({cur.tick, static_cast<uint32_t>(cur.pos), cur.runningStatus});
+
+        // Pass 2 – unchecked decode of the batch just proven in bounds.
+        for (size_t i = 0; i < m_indexCount; ++i) {
+            const IndexedEvent& ie = m_index[i];
+            const uint8_t*      p  = base + ie.pos;
+
+            if (ie.type == 0xff) {
+                uint32_t uspqn = (p[0] << 16) | (p[1] << 8) | p[2];
+                double newBPM = 60000000.0 / uspqn;
+                tempoChanges.emplace_back(ie.tick, newBPM, uspqn);
+                if (tempoChanges.size() == 1) bpm = newBPM;
+                if (record) seek->seekable = false;
+                continue;
+            }
+
+            uint8_t note = p[0] & 0x7f;
+            uint8_t vel  = p[1];
+            if (note < minPitch || note > maxPitch) continue;
+
+            if (ie.type == 0x90 && vel > 0) {
+                if (sustainNotes)
+                    activeNotes[note] = {ie.tick, vel, true};
+                else if (vel >= minVel && vel <= maxVel && ie.tick - winStart < winSpan)
+                    events.emplace_back(ie.tick, note, vel, 0u);
+            } else if (sustainNotes) {   // note-off (0x80 or 0x90 vel=0)
+                ActiveNote& a = activeNotes[note];
+                if (a.on && a.vel >= minVel && a.vel <= maxVel && a.tick - winStart < winSpan)
+                    events.emplace_back(a.tick, note, a.vel, ie.tick - a.tick);
+                a.on = false;
+            }
+        }
+
+        // Past the window: done once no kept note is still waiting for its
+        // note-off.  (Recording needs the whole track.)
+        if (cur.tick >= filter.endTick && !record) {
+            bool pending = false;
+            if (sustainNotes)
+                for (const ActiveNote& a : activeNotes)
+                    pending |= a.on && a.tick - winStart < winSpan;
+            if (!pending) break;
+        }
+    }
+
+    if (!events.empty())
+        tracks.push_back(std::move(events));
+    return true;
+}
+
 // ─── parse ────────────────────────────────────────────────────────────────────
 
 bool MIDIParser::parse(const std::string& filename, bool sustainNotes, int minVelocity) {
+    MIDIFilter filter;
+    filter.minVelocity = static_cast<uint8_t>(minVelocity);
+    return parse(filename, sustainNotes, filter);
+}
+
+bool MIDIParser::parse(const std::string& filename, bool sustainNotes, const MIDIFilter& filter) {
+    errorMessage.clear();
+    skippedTracks = 0;
+    m_skipRun     = selectRunSkipper();
+
     std::ifstream file(filename, std::ios::binary);
-    if (!file) return false;
+    if (!file) {
+        errorMessage = "cannot open file";
+        return false;
+    }
 
     file.seekg(0, std::ios::end);
     size_t fileSize = static_cast<size_t>(file.tellg());
     file.seekg(0, std::ios::beg);
 
+    if (fileSize > UINT32_MAX) {
+        errorMessage = "file too large";
+        return false;
+    }
+
     m_data.resize(fileSize);
-    file.read(reinterpret_cast<char*>(m_data.data()), fileSize);
+    for (size_t done = 0; done < fileSize; ) {
+        if (stopped()) return false;
+        size_t n = std::min(kReadChunk, fileSize - done);
+        if (!file.read(reinterpret_cast<char*>(m_data.data() + done), n)) {
+            errorMessage = "read error";
+            return false;
+        }
+        done += n;
+    }
     file.close();
 
     m_pos = 0;
 
     // Header chunk
-    if (read32() != 0x4D546864) return false;   // "MThd"
-    if (read32() != 6)          return false;   // header length
+    if (m_data.size() < 14)     return fail(0, "file too small for an MThd header");
+    if (read32() != 0x4D546864) return fail(0, "missing MThd signature");   // "MThd"
+    if (read32() != 6)          return fail(4, "unexpected MThd length");    // header length
 
-    /* uint16_t format = */ read16();
+    uint16_t format    = read16();
     uint16_t numTracks = read16();
     ppq = read16();
+    if (ppq == 0 || (ppq & 0x8000))
+        return fail(12, "unsupported time division (SMPTE or zero)");
 
     tracks.clear();
     tempoChanges.clear();
 
-    for (uint16_t t = 0; t < numTracks && m_pos < m_data.size(); ++t) {
+    // Seek index: recorded afresh, or used only if it was made for this file.
+    const bool record = buildSeekIndex && !m_tempoOnly;
+    if (record) {
+        seekIndex          = SeekIndex{};
+        seekIndex.fileSize = fileSize;
+        seekIndex.tracks.resize(numTracks);
+    }
+    m_useSeekIndex = !record && filter.hasWindow() && seekIndex.fileSize == fileSize &&
+                     seekIndex.tracks.size() == numTracks;
+
+    for (uint16_t t = 0; t < numTracks && m_pos < m_data.size(); ) {
+        if (stopped()) return false;
+        if (m_tempoOnly && format == 1 && t > 0) break;
         if (progressCallback && numTracks > 0)
             progressCallback(static_cast<double>(t) / numTracks);
 
-        if (read32() != 0x4D54726B) continue;   // "MTrk"
+        size_t chunkPos = m_pos;
+        if (m_data.size() - m_pos < 8)
+            return fail(chunkPos, "truncated chunk header");
 
-        uint32_t trackLen = read32();
-        size_t   trackEnd = m_pos + trackLen;
+        uint32_t chunkId  = read32();
+        uint32_t chunkLen = read32();
+        if (chunkLen > m_data.size() - m_pos)
+            return fail(chunkPos, "chunk length exceeds file size");
 
-        std::vector<MIDINote> events;
-        events.reserve(10000);
-
-        uint32_t time          = 0;
-        uint8_t  runningStatus = 0;
-        std::map<uint8_t, std::pair<uint32_t, uint8_t>> activeNotes;
-
-        while (m_pos < trackEnd && m_pos < m_data.size()) {
-            uint32_t delta = readVarLen();
-            time += delta;
-
-            uint8_t status = m_data[m_pos];
-            if (status < 0x80) {
-                status = runningStatus;
-            } else {
-                ++m_pos;
-            }
-            runningStatus = status;
+        size_t chunkEnd = m_pos + chunkLen;
+        if (chunkId != 0x4D54726B) {   // not "MTrk" – skip alien chunk
+            m_pos = chunkEnd;
+            continue;
+        }
 
-            uint8_t type = status & 0xf0;
-
-            if (type == 0x90 || type == 0x80) {
-                uint8_t note = m_data[m_pos++];
-                uint8_t vel  = m_data[m_pos++];
-
-                if (type == 0x90 && vel > 0) {
-                    if (sustainNotes) {
-                        activeNotes[note] = {time, vel};
-                    } else if (vel >= static_cast<uint8_t>(minVelocity)) {
-                        events.emplace_back(time, note, vel, 0u);
-                    }
-                } else {   // note-off (0x80 or 0x90 vel=0)
-                    if (sustainNotes) {
-                        auto it = activeNotes.find(note);
-                        if (it != activeNotes.end() &&
-                            it->second.second >= static_cast<uint8_t>(minVelocity)) {
-                            uint32_t dur = time - it->second.first;
-                            events.emplace_back(it->second.first, note, it->second.second, dur);
-                        }
-                        activeNotes.erase(note);
-                    }
-                }
-            } else if (type == 0xb0 || type == 0xe0 || type == 0xa0) {
-                m_pos += 2;
-            } else if (type == 0xc0 || type == 0xd0) {
-                m_pos += 1;
-            } else if (status == 0xff) {
-                uint8_t  metaType = m_data[m_pos++];
-                uint32_t len      = readVarLen();
-
-                if (metaType == 0x51 && len == 3) {
-                    uint32_t uspqn = (m_data[m_pos] << 16) |
-                                     (m_data[m_pos + 1] << 8) |
-                                      m_data[m_pos + 2];
-                    double newBPM = 60000000.0 / uspqn;
-                    tempoChanges.emplace_back(time, newBPM);
-                    if (tempoChanges.size() == 1) bpm = newBPM;
-                }
-                m_pos += len;
-            } else if (status == 0xf0 || status == 0xf7) {
-                uint32_t len = readVarLen();
-                m_pos += len;
-            }
+        // The format-1 conductor track carries the tempo map, so it is always
+        // decoded; only its notes are subject to track selection.
+        bool wanted    = wantTrack(t, m_pos, chunkEnd, filter);
+        bool conductor = (format == 1 && t == 0);
+        if (!wanted && !conductor) {
+            ++skippedTracks;
+            m_pos = chunkEnd;
+            ++t;
+            continue;
         }
 
-        if (!events.empty())
-            tracks.push_back(std::move(events));
+        m_channelMask = wanted ? filter.channelMask : 0;
+        SeekIndex::Track* seek = (record || m_useSeekIndex) ? &seekIndex.tracks[t] : nullptr;
+        if (!parseTrack(m_pos, chunkEnd, sustainNotes, filter, seek))
+            return false;
+        m_pos = chunkEnd;
+        ++t;
     }
 
+    // Everything needed from here on is in the decoded vectors.
+    bufferBytes = m_data.capacity() + m_index.capacity() * sizeof(IndexedEvent);
+    std::vector<uint8_t>().swap(m_data);
+    std::vector<IndexedEvent>().swap(m_index);
     return true;
 }
+
+size_t MIDIParser::resultBytes() const {
+    size_t bytes = tracks.capacity() * sizeof(tracks[0]) +
+                   tempoChanges.capacity() * sizeof(TempoChange);
+    for (const auto& track : tracks) bytes += track.capacity() * sizeof(MIDINote);
+    return bytes;
+}
+
+bool MIDIParser::parseTempoMap(const std::string& filename) {
+    MIDIFilter filter;
+    filter.channelMask = 0;   // index tempo events only
+
+    m_tempoOnly = true;
+    bool ok     = parse(filename, false, filter);
+    m_tempoOnly = false;
+    return ok;
+}
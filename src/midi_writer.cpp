@@ -0,0 +1,274 @@
+#include "midi_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "chart_reader.h"
+#include "output_writer.h"
+#include "tempo_map.h"
+
+namespace {
+
+// ─── SMF encoding ─────────────────────────────────────────────────────────────
+
+void putBE(std::string& out, uint32_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+void putVarLen(std::string& out, uint32_t v) {
+    char buf[5];
+    int  n   = 0;
+    buf[n++] = static_cast<char>(v & 0x7f);
+    while (v >>= 7) buf[n++] = static_cast<char>(0x80 | (v & 0x7f));
+    while (n > 0) out += buf[--n];
+}
+
+void putMeta(std::string& out, uint32_t delta, uint8_t type, const std::string& data) {
+    putVarLen(out, delta);
+    out += '\xff';
+    out += static_cast<char>(type);
+    putVarLen(out, static_cast<uint32_t>(data.size()));
+    out += data;
+}
+
+// Appends an MTrk chunk holding `events` and an end-of-track.
+void putTrack(std::string& file, const std::string& events) {
+    file += "MTrk";
+    putBE(file, static_cast<uint32_t>(events.size() + 4), 4);
+    file += events;
+    file.append("\x00\xff\x2f\x00", 4);
+}
+
+struct Note {
+    uint32_t on, off;
+    uint8_t  lane;    // within the player
+    uint8_t  pitch;   // assigned by noteTrack()
+};
+
+// Note track with running status; note-offs are note-ons at velocity 0.
+//
+// Each lane's notes take pitch base + lane, or k, 2k, … above it when that
+// pitch is still sounding or already starts at the same tick, so stacked and
+// overlapping notes keep their own note-off.  Past pitch 127 a note ends the
+// one before it instead; `dropped` counts exact duplicates there.
+std::string noteTrack(std::vector<Note>& notes, int base, int k, uint8_t velocity,
+                      size_t& dropped) {
+    std::sort(notes.begin(), notes.end(), [](const Note& a, const Note& b) {
+        return a.lane < b.lane || (a.lane == b.lane && a.on < b.on);
+    });
+    std::vector<size_t> layerLast;   // per layer of the current lane: last note
+    size_t kept = 0;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        Note n = notes[i];
+        if (i == 0 || n.lane != notes[i - 1].lane) layerLast.clear();
+
+        size_t layer = 0;
+        while (layer < layerLast.size()) {
+            const Note& last = notes[layerLast[layer]];
+            if (last.off <= n.on && last.on != n.on) break;
+            ++layer;
+        }
+        if (base + n.lane + static_cast<int>(layer) * k > 127) {
+            layer = 0;
+            Note& last = notes[layerLast[0]];
+            if (last.on == n.on) { ++dropped; continue; }
+            last.off = std::min(last.off, n.on);
+        }
+        n.pitch = static_cast<uint8_t>(base + n.lane + static_cast<int>(layer) * k);
+        notes[kept] = n;
+        if (layer == layerLast.size()) layerLast.push_back(kept);
+        else                           layerLast[layer] = kept;
+        ++kept;
+    }
+    notes.resize(kept);
+
+    // At one tick: held notes end, then notes start, then zero-length ones end.
+    struct Event { uint32_t tick; uint8_t order, pitch, velocity; };
+    std::vector<Event> events;
+    events.reserve(notes.size() * 2);
+    for (const Note& n : notes) {
+        events.push_back({n.on, 1, n.pitch, velocity});
+        events.push_back({n.off, static_cast<uint8_t>(n.off == n.on ? 2 : 0), n.pitch, 0});
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.tick < b.tick || (a.tick == b.tick && a.order < b.order);
+    });
+
+    std::string out;
+    out.reserve(events.size() * 4 + 16);
+    uint32_t last = 0;
+    for (size_t i = 0; i < events.size(); ++i) {
+        putVarLen(out, events[i].tick - last);
+        if (i == 0) out += '\x90';
+        out += static_cast<char>(events[i].pitch);
+        out += static_cast<char>(events[i].velocity);
+        last = events[i].tick;
+    }
+    return out;
+}
+
+} // namespace
+
+// ─── write ────────────────────────────────────────────────────────────────────
+
+bool MIDIWriter::write(const ChartData& chart, const std::string& p1File, const std::string& p2File) {
+    droppedNotes = p1Notes = p2Notes = 0;
+    if (ppq == 0) {
+        ppq = 3840;
+        while (ppq > 1 && chart.sections.size() > UINT32_MAX / (4u * ppq)) ppq /= 2;
+    }
+    if (ppq & 0x8000) {
+        errorMessage = "PPQ must be between 1 and 32767";
+        return false;
+    }
+    if (p1File == p2File) {
+        errorMessage = "P1 and P2 need different output files";
+        return false;
+    }
+
+    // ── Tempo map: section starts and changeBPM section ends ────────────────
+    auto validBPM = [](double bpm) { return std::isfinite(bpm) && bpm >= 3.6 && bpm <= 60e6; };
+    if (!validBPM(chart.bpm)) {
+        errorMessage = "chart bpm " + std::to_string(chart.bpm) + " is out of range";
+        return false;
+    }
+    const uint32_t sectionTicks = 4u * ppq;
+    if (chart.sections.size() > UINT32_MAX / sectionTicks) {
+        errorMessage = "chart too long for PPQ " + std::to_string(ppq) + ": at most " +
+                       std::to_string(UINT32_MAX / sectionTicks) + " sections";
+        return false;
+    }
+    std::vector<TempoChange> tempo{TempoChange(0, chart.bpm)};
+    auto setTempo = [&](const TempoChange& tc) {
+        if (tc.usPerQuarter == tempo.back().usPerQuarter) return;
+        if (tc.tick == tempo.back().tick) tempo.back() = tc;
+        else                              tempo.push_back(tc);
+    };
+    double endBPM = chart.bpm;   // tempo in effect at the end of the previous section
+    for (size_t i = 0; i < chart.sections.size(); ++i) {
+        const Section& s = chart.sections[i];
+        if (!validBPM(s.bpm)) {
+            errorMessage = "section " + std::to_string(i) + " bpm " + std::to_string(s.bpm) +
+                           " is out of range";
+            return false;
+        }
+        const uint32_t from = static_cast<uint32_t>(i * sectionTicks);
+        TempoChange    start(from, s.changeBPM ? endBPM : s.bpm);
+        setTempo(start);
+        endBPM = s.bpm;
+
+        // A changeBPM section lasts 4 beats of its start tempo and ends on its
+        // bpm.  Its last tick takes that bpm, strictly inside the section so
+        // reconverting flags it again; the n ticks before it run at whatever
+        // tempo keeps the section's length exact:
+        //   n * x = (n + 1) * start - end   (in µs per quarter)
+        // split as n - 1 ticks of x and one that takes the remainder.
+        const TempoChange end(from + sectionTicks - 1, s.bpm);
+        if (!s.changeBPM || end.usPerQuarter == start.usPerQuarter) continue;
+        const int64_t us0 = start.usPerQuarter, us1 = end.usPerQuarter;
+        for (int64_t n = 1; n + 2 <= sectionTicks; ++n) {
+            const int64_t d = (n + 1) * us0 - us1;
+            if (d < n) continue;
+            const int64_t x = d / n, last = d - (n - 1) * x;
+            if (last > 0xffffff) continue;
+            if (n > 1) setTempo(TempoChange(static_cast<uint32_t>(end.tick - n), 60e6 / x,
+                                            static_cast<uint32_t>(x)));
+            setTempo(TempoChange(end.tick - 1, 60e6 / last, static_cast<uint32_t>(last)));
+            break;
+        }
+        // (No split fits when the tempos are thousands of times apart at this
+        // PPQ: the section then runs one tick of the difference long.)
+        setTempo(end);
+    }
+
+    // ── Notes → ticks, split by player ──────────────────────────────────────
+    TempoMap map(ppq, tempo, 1.0);
+
+    // Nearest tick to a chart time.  The tempo is constant over most of a
+    // section, so interpolating from its start lands on or next to the
+    // answer; notes that don't (a changeBPM section's last ticks, offset past
+    // the section, long sustains) are bisected.
+    auto tickAt = [&](double ms, uint32_t from, int64_t fromNs, double nsPerTick) -> uint32_t {
+        const int64_t ns = std::llround(ms * 1e6);
+        if (ns <= 0) return 0;
+        auto firstAtOrAfter = [&](uint32_t t) {
+            return map.ticksToNs(t) >= ns && (t == 0 || map.ticksToNs(t - 1) < ns);
+        };
+        double   guess = std::ceil(from + (ns - fromNs) / nsPerTick);
+        uint32_t tick  = guess >= 0.0 && guess < 4294967295.0 ? static_cast<uint32_t>(guess) : 0;
+        if (!firstAtOrAfter(tick)) {
+            if      (tick < UINT32_MAX && firstAtOrAfter(tick + 1)) ++tick;
+            else if (tick > 0 && firstAtOrAfter(tick - 1))          --tick;
+            else                                                    tick = map.nsToTick(ns);
+        }
+        if (tick > 0 && ns - map.ticksToNs(tick - 1) < map.ticksToNs(tick) - ns) --tick;
+        return tick;
+    };
+
+    bool hasSustains = false;
+    for (const auto& s : chart.sections)
+        for (const auto& n : s.notes) hasSustains |= n.duration > 0.0;
+
+    const int     k    = std::max(1, chart.keyCount());
+    const int     base = std::min((60 + k - 1) / k * k, 128 - k);   // lane 0's pitch
+    std::vector<Note> players[2];
+    players[0].reserve(chart.noteCount);
+    players[1].reserve(chart.noteCount);
+    for (size_t i = 0; i < chart.sections.size(); ++i) {
+        const Section& s         = chart.sections[i];
+        const uint32_t from      = static_cast<uint32_t>(i * sectionTicks);
+        const int64_t  fromNs    = map.ticksToNs(from);
+        const double   nsPerTick = static_cast<double>(map.ticksToNs(from + sectionTicks) - fromNs) /
+                                   sectionTicks;
+        for (const auto& n : s.notes) {
+            if (n.lane < 0 || n.lane >= 2 * k) { ++droppedNotes; continue; }
+            bool firstHalf = n.lane < k;
+            bool isP1      = s.mustHitSection ? firstHalf : !firstHalf;
+            uint32_t on    = tickAt(n.time, from, fromNs, nsPerTick);
+            // A note just before the section's end stays in its last tick.
+            if (on == from + sectionTicks && std::llround(n.time * 1e6) < map.ticksToNs(on)) --on;
+            uint32_t off   = n.duration > 0.0 ? tickAt(n.time + n.duration, from, fromNs, nsPerTick)
+                           : hasSustains      ? on
+                                              : on + std::max<uint32_t>(1, ppq / 4);
+            players[isP1 ? 0 : 1].push_back(
+                {on, std::max(on, off), static_cast<uint8_t>(n.lane % k), 0});
+        }
+    }
+
+    // ── Files ───────────────────────────────────────────────────────────────
+    std::string conductor;
+    if (!chart.songName.empty()) putMeta(conductor, 0, 0x03, chart.songName);
+    putMeta(conductor, 0, 0x58, std::string("\x04\x02\x18\x08", 4));
+    uint32_t last = 0;
+    for (const auto& tc : tempo) {
+        std::string us;
+        putBE(us, std::min<uint32_t>(tc.usPerQuarter, 0xffffff), 3);
+        putMeta(conductor, tc.tick - last, 0x51, us);
+        last = tc.tick;
+    }
+
+    OutputWriter writer({p1File, p2File});
+    for (size_t i = 0; i < 2; ++i) {
+        std::string notes = noteTrack(players[i], base, k, velocity, droppedNotes);
+        (i == 0 ? p1Notes : p2Notes) = players[i].size();
+
+        std::string file = "MThd";
+        putBE(file, 6, 4);
+        putBE(file, 1, 2);   // format 1
+        putBE(file, 2, 2);   // conductor + notes
+        putBE(file, ppq, 2);
+        putTrack(file, conductor);
+        putTrack(file, notes);
+
+        if (!writer.open(i, file.size()) || !writer.write(i, file.data(), file.size())) {
+            errorMessage = writer.errorMessage;
+            return false;
+        }
+    }
+    if (!writer.commit()) {
+        errorMessage = writer.errorMessage;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,341 @@
+#include "output_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// ─── Constructor / destructor ─────────────────────────────────────────────────
+
+OutputWriter::OutputWriter(std::vector<std::string> names, size_t bufferBytes)
+    : m_bufferBytes(std::max<size_t>(bufferBytes, 4096)) {
+    m_files.reserve(names.size());
+    for (auto& n : names) {
+        m_files.push_back(std::make_unique<File>());
+        m_files.back()->name = std::move(n);
+    }
+    m_thread = std::thread(&OutputWriter::ioLoop, this);
+}
+
+OutputWriter::~OutputWriter() {
+    if (!m_committed) discard();   // needs the I/O thread to drain first
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobReady.notify_all();
+    m_thread.join();
+}
+
+// ─── Producer side ────────────────────────────────────────────────────────────
+
+bool OutputWriter::fail(File& f, const std::string& reason) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    f.failed = true;
+    f.error  = reason;
+    errorMessage = f.name + ": " + reason;
+    return false;
+}
+
+bool OutputWriter::open(size_t file, size_t sizeHint) {
+    File& f = *m_files[file];
+    std::string error;
+    if (m_codec != StreamCompressor::kNone) {
+        f.compressor = std::make_unique<StreamCompressor>();
+        if (!f.compressor->begin(m_codec, m_level, error)) return fail(f, error);
+    }
+    // A single write doesn't fragment; preallocating only pays past that.
+    f.reserved = sizeHint > m_bufferBytes && !f.compressor;
+    if (!createPart(f, f.reserved ? sizeHint : 0, error)) return fail(f, error);
+
+    f.isOpen = true;
+    f.offset = 0;
+    f.stored = 0;
+    // Room for one section past the flush mark, or the whole of a small file.
+    size_t cap = m_bufferBytes + m_bufferBytes / 4;
+    f.fill.reserve(sizeHint > 0 ? std::min(sizeHint, cap) : cap);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_peakOpen = std::max(m_peakOpen, ++m_openFiles);
+    return true;
+}
+
+bool OutputWriter::flush(size_t file, bool force) {
+    File& f = *m_files[file];
+    if (f.fill.size() < (force ? 1 : m_bufferBytes)) return !f.failed;
+    return handOff(file, false);
+}
+
+bool OutputWriter::handOff(size_t file, bool last) {
+    File& f = *m_files[file];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobDone.wait(lock, [&] { return !f.inFlight; });
+    if (f.failed) {
+        errorMessage = f.name + ": " + f.error;
+        return false;
+    }
+
+    // Swap buffers: the full one goes to the I/O thread, the spare it
+    // returned last time becomes the fill buffer.
+    m_jobs.push_back({file, f.offset, std::move(f.fill), last});
+    f.offset  += m_jobs.back().data.size();
+    f.fill     = std::move(f.spare);
+    f.fill.clear();
+    f.inFlight = true;
+    lock.unlock();
+    m_jobReady.notify_one();
+    return true;
+}
+
+bool OutputWriter::write(size_t file, const char* data, size_t n) {
+    File& f = *m_files[file];
+    while (n > 0) {
+        size_t room = m_bufferBytes - std::min(m_bufferBytes, f.fill.size());
+        size_t take = std::min(n, room);
+        if (take == 0) {
+            if (!flush(file, true)) return false;
+            continue;
+        }
+        f.fill.append(data, take);
+        data += take;
+        n    -= take;
+        if (!flush(file)) return false;
+    }
+    return !f.failed;
+}
+
+bool OutputWriter::close(size_t file) {
+    File& f = *m_files[file];
+    if (!f.isOpen) return !f.failed;
+
+    bool ok;
+    if (f.offset == 0 && !f.failed && !f.compressor) {   // never handed off: write it here
+        std::string error;
+        ok = writeAt(f, f.fill.data(), f.fill.size(), 0, error);
+        if (!ok) fail(f, error);
+        f.offset = f.stored = f.fill.size();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_openFiles;
+    } else {
+        // A compressed stream always gets a last job, to write its trailer.
+        ok = f.compressor && !f.failed ? handOff(file, true) : flush(file, true);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobDone.wait(lock, [&] { return !f.inFlight; });
+        --m_openFiles;
+    }
+    f.isOpen = false;
+    std::string().swap(f.fill);
+    std::string().swap(f.spare);
+    if (!f.compressor) f.stored = f.offset;
+
+    if (!closeHandle(f, true) && ok) return fail(f, "cannot set the file size");
+    if (ok && f.failed) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        errorMessage = f.name + ": " + f.error;
+    }
+    return ok && !f.failed;
+}
+
+// ─── Commit / discard ─────────────────────────────────────────────────────────
+
+bool OutputWriter::commit() {
+    for (size_t i = 0; i < m_files.size(); ++i) {
+        if (!close(i)) {
+            discard();
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < m_files.size(); ++i) {
+        const std::string& name = m_files[i]->name;
+        std::error_code ec;
+        fs::rename(name + ".part", name, ec);
+        if (ec) {   // some platforms won't rename over an existing file
+            fs::remove(name, ec);
+            fs::rename(name + ".part", name, ec);
+        }
+        if (ec) {
+            errorMessage = name + ": " + ec.message();
+            for (size_t j = i; j < m_files.size(); ++j)
+                fs::remove(m_files[j]->name + ".part", ec);
+            m_committed = true;
+            return false;
+        }
+    }
+    m_committed = true;
+    return true;
+}
+
+void OutputWriter::discard() {
+    for (auto& fp : m_files) {
+        File& f = *fp;
+        if (f.isOpen) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobDone.wait(lock, [&] { return !f.inFlight; });
+                --m_openFiles;
+            }
+            f.isOpen = false;
+            closeHandle(f, false);
+        }
+        std::error_code ec;
+        fs::remove(f.name + ".part", ec);
+    }
+    m_committed = true;
+}
+
+// ─── I/O thread ───────────────────────────────────────────────────────────────
+
+void OutputWriter::ioLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobReady.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        File& f = *m_files[job.file];
+        std::string error;
+        bool ok;
+        if (f.failed) {
+            ok = true;
+        } else if (f.compressor) {
+            // The compressed stream goes on where the last job's ended.
+            auto start = std::chrono::steady_clock::now();
+            ok = f.compressor->compress(job.data.data(), job.data.size(), f.packed, job.last, error);
+            m_compressNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count());
+            ok = ok && writeAt(f, f.packed.data(), f.packed.size(), f.stored, error);
+            f.stored += f.packed.size();
+            f.packed.clear();
+        } else {
+            ok = writeAt(f, job.data.data(), job.data.size(), job.offset, error);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!ok) {
+                f.failed = true;
+                f.error  = error;
+            }
+            job.data.clear();
+            f.spare    = std::move(job.data);
+            f.inFlight = false;
+        }
+        m_jobDone.notify_all();
+    }
+}
+
+// ─── Platform layer ───────────────────────────────────────────────────────────
+
+#ifdef _WIN32
+
+bool OutputWriter::createPart(File& f, size_t reserve, std::string& error) {
+    HANDLE h = CreateFileA((f.name + ".part").c_str(), GENERIC_WRITE, 0, nullptr,
+                           CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        error = "cannot create file (error " + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+    // Extending the end of file reserves the clusters up front; close()
+    // trims it back to what was written.
+    if (reserve > 0) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(reserve);
+        if (SetFilePointerEx(h, end, nullptr, FILE_BEGIN)) SetEndOfFile(h);
+    }
+    f.handle = h;
+    return true;
+}
+
+bool OutputWriter::writeAt(File& f, const char* data, size_t n, uint64_t offset,
+                           std::string& error) {
+    while (n > 0) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(n, size_t(1) << 30));
+        DWORD done  = 0;
+        OVERLAPPED at = {};   // positioned write on a synchronous handle
+        at.Offset     = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        if (!WriteFile(static_cast<HANDLE>(f.handle), data, chunk, &done, &at) || done == 0) {
+            error = "write failed (error " + std::to_string(GetLastError()) + ")";
+            return false;
+        }
+        data   += done;
+        n      -= done;
+        offset += done;
+    }
+    return true;
+}
+
+bool OutputWriter::closeHandle(File& f, bool trim) {
+    if (!f.handle) return true;
+    HANDLE h  = static_cast<HANDLE>(f.handle);
+    bool   ok = true;
+    if (trim && f.reserved) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(f.offset);
+        ok = SetFilePointerEx(h, end, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+    }
+    CloseHandle(h);
+    f.handle = nullptr;
+    return ok;
+}
+
+#else
+
+bool OutputWriter::createPart(File& f, size_t reserve, std::string& error) {
+    int fd = ::open((f.name + ".part").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+#ifdef __linux__
+    // Best effort: reserves contiguous extents up front.  Filesystems without
+    // support just grow the file as it is written.
+    if (reserve > 0) posix_fallocate(fd, 0, static_cast<off_t>(reserve));
+#else
+    (void)reserve;
+#endif
+    f.fd = fd;
+    return true;
+}
+
+bool OutputWriter::writeAt(File& f, const char* data, size_t n, uint64_t offset,
+                           std::string& error) {
+    while (n > 0) {
+        ssize_t done = ::pwrite(f.fd, data, n, static_cast<off_t>(offset));
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            error = std::strerror(errno);
+            return false;
+        }
+        data   += done;
+        n      -= static_cast<size_t>(done);
+        offset += static_cast<uint64_t>(done);
+    }
+    return true;
+}
+
+bool OutputWriter::closeHandle(File& f, bool trim) {
+    if (f.fd < 0) return true;
+    bool ok = !trim || !f.reserved || ::ftruncate(f.fd, static_cast<off_t>(f.offset)) == 0;
+    ok = ::close(f.fd) == 0 && ok;
+    f.fd = -1;
+    return ok;
+}
+
+#endif
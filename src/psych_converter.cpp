@@ -3,14 +3,28 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <cstdio>
 #include <execution>
+#include <filesystem>
 #include <fstream>
 #include <future>
 #include <iomanip>
 #include <sstream>
-
+#include <thread>
+#include <type_traits>
+
+#include "binary_chart.h"
+#include "cancel_token.h"
+#include "chart_fingerprint.h"
+#include "chart_reader.h"
+#include "cpu_features.h"
+#include "file_watcher.h"
 #include "gui_logger.h"
+#include "midi_writer.h"
+#include "output_writer.h"
 #include "progress_bar.h"
+#include "tempo_map.h"
 #include "utils.h"
 
 // ─── ticksToMs ───────────────────────────────────────────────────────────────
@@ -49,6 +63,17 @@ double PsychConverter::ticksToMs(uint32_t ticks, double finalBPM, uint16_t ppq,
     return ms;
 }
 
+// ─── Cancellation ─────────────────────────────────────────────────────────────
+
+bool PsychConverter::stopRequested() const {
+    return m_cancel && m_cancel->stopRequested();
+}
+
+void PsychConverter::logStopped() const {
+    guiLogger.logColored(std::string("\n[X] Conversion stopped: ") + m_cancel->reason() +
+                         " (no output written)\n", RED);
+}
+
 // ─── getBPMAtTime ─────────────────────────────────────────────────────────────
 
 double PsychConverter::getBPMAtTime(double time,
@@ -62,210 +87,679 @@ double PsychConverter::getBPMAtTime(double time,
     return baseBPM;
 }
 
-// ─── buildJSON ────────────────────────────────────────────────────────────────
-
-std::string PsychConverter::buildJSON(const std::vector<Section>& sections,
-                                       double finalBPM) const {
-    std::ostringstream json;
-    json << std::fixed;
-    if (m_config.highPrecision)
-        json << std::setprecision(m_config.decimalPlaces);
-
-    json << R"({"song":{"song":")" << m_config.songName << R"(","notes":[)";
+// ─── JSON serialisation ──────────────────────────────────────────────────────
 
-    for (size_t s = 0; s < sections.size(); ++s) {
-        if (s > 0) json << ",";
-        json << R"({"sectionNotes":[)";
+SectionFormat PsychConverter::sectionFormat() const {
+    SectionFormat fmt;
+    fmt.decimalPlaces = m_config.decimalPlaces;
+    if (m_config.roundTimesTo >= 0) fmt.roundMult = std::pow(10.0, m_config.roundTimesTo);
+    return fmt;
+}
 
-        const auto& notes = sections[s].notes;
-        for (size_t i = 0; i < notes.size(); ++i) {
-            if (i > 0) json << ",";
+std::string PsychConverter::songFieldsJSON(double finalBPM) const {
+    std::string json = R"("bpm":)" + smartNumToStr(finalBPM, m_config.decimalPlaces)
+          + R"(,"needsVoices":true,"speed":)" + smartNumToStr(m_config.speed, m_config.decimalPlaces);
 
-            double time = notes[i].time;
-            double dur  = notes[i].duration;
+    json += R"(,"player1":")"   + m_config.p1Char
+          + R"(","player2":")"  + m_config.p2Char
+          + R"(","gfVersion":")" + m_config.gfChar
+          + R"(","stage":")"    + m_config.stage + '"';
 
-            if (m_config.roundTimesTo >= 0) {
-                double mult = std::pow(10.0, m_config.roundTimesTo);
-                time = std::round(time * mult) / mult;
-                dur  = std::round(dur  * mult) / mult;
-            }
+    // Include mania field only if not default (mania=3)
+    if (m_config.mania != 3)
+        json += R"(,"mania":)" + std::to_string(m_config.mania);
 
-            json << "[" << smartNumToStr(time, m_config.decimalPlaces)
-                 << "," << notes[i].lane << ",0,";
+    // Always include validScore
+    json += R"(,"validScore":true)";
 
-            if (m_config.minifyJSON && dur == 0.0)
-                json << "0]";
-            else
-                json << smartNumToStr(dur, m_config.decimalPlaces) << "]";
-        }
+    return json;
+}
 
-        json << R"(],"lengthInSteps":16,"mustHitSection":)"
-             << (sections[s].mustHitSection ? "true" : "false")
-             << R"(,"changeBPM":)" << (sections[s].changeBPM ? "true" : "false")
-             << R"(,"bpm":)" << smartNumToStr(sections[s].bpm, m_config.decimalPlaces)
-             << "}";
-    }
+// ─── Song metadata ────────────────────────────────────────────────────────────
 
-    json << R"(],"bpm":)"      << smartNumToStr(finalBPM,           m_config.decimalPlaces)
-         << R"(,"needsVoices":true,"speed":)" << smartNumToStr(m_config.speed, m_config.decimalPlaces);
+std::string PsychConverter::chartHead() const {
+    return R"({"song":{"song":")" + m_config.songName + R"(","notes":[)";
+}
 
-    json << R"(,"player1":")"  << m_config.p1Char
-         << R"(","player2":")" << m_config.p2Char
-         << R"(","gfVersion":")" << m_config.gfChar
-         << R"(","stage":")"   << m_config.stage << '"';  // Close the stage string properly
+std::string PsychConverter::chartTail(double finalBPM) const {
+    return "]," + songFieldsJSON(finalBPM) + "}}";
+}
 
-    // Include mania field only if not default (mania=3)
-    if (m_config.mania != 3)
-        json << R"(,"mania":)" << m_config.mania;
-    
-    // Always include validScore
-    json << R"(,"validScore":true}})";
+std::string PsychConverter::manifestSong(double finalBPM) const {
+    return R"({"song":{"song":")" + m_config.songName + "\"," + songFieldsJSON(finalBPM) + "}";
+}
 
-    return json.str();
+std::pair<std::string, std::string>
+PsychConverter::fileMetadata(size_t file, size_t fileCount, double finalBPM) const {
+    if (!sharding())            return {chartHead(), chartTail(finalBPM)};
+    if (file + 1 == fileCount)  return {manifestSong(finalBPM), ""};
+    return {};   // shards hold only sections
 }
 
 // ─── splitSections ────────────────────────────────────────────────────────────
 
-std::vector<std::vector<Section>>
+std::vector<std::pair<size_t, size_t>>
 PsychConverter::splitSections(const std::vector<Section>& sections, int notesPerChunk) const {
-    std::vector<std::vector<Section>> chunks;
-    std::vector<Section> current;
-    int count = 0;
-
-    for (const auto& sec : sections) {
-        int n = static_cast<int>(sec.notes.size());
-        if (count + n > notesPerChunk && !current.empty()) {
-            chunks.push_back(std::move(current));
-            current.clear();
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t first = 0;
+    int    count = 0;
+
+    for (size_t s = 0; s < sections.size(); ++s) {
+        int n = static_cast<int>(sections[s].notes.size());
+        if (count + n > notesPerChunk && s > first) {
+            chunks.push_back({first, s});
+            first = s;
             count = 0;
         }
-        current.push_back(sec);
         count += n;
     }
-    if (!current.empty()) chunks.push_back(std::move(current));
+    if (first < sections.size()) chunks.push_back({first, sections.size()});
     return chunks;
 }
 
-// ─── convert ─────────────────────────────────────────────────────────────────
+// ─── shardSections ───────────────────────────────────────────────────────────
+
+std::vector<std::pair<size_t, size_t>>
+PsychConverter::shardSections(const BuiltChart& chart,
+                              const std::vector<size_t>& sectionBytes) const {
+    std::vector<std::pair<size_t, size_t>> shards;
+    const auto& times = chart.sectionTimes;
+    // Bytes of a shard file: {"firstSection":N,"notes":[…]} around the sections.
+    auto wrapper = [](size_t first) { return 28 + std::to_string(first).size(); };
+    size_t first = 0, bytes = wrapper(0);
+
+    for (size_t s = 0; s < sectionBytes.size(); ++s) {
+        bool overBytes = m_config.shardBytes > 0 && bytes + sectionBytes[s] > m_config.shardBytes;
+        bool overTime  = m_config.shardMs > 0.0 && times[s + 1] - times[first] > m_config.shardMs;
+        if ((overBytes || overTime) && s > first) {
+            shards.push_back({first, s});
+            first = s;
+            bytes = wrapper(s);
+        }
+        bytes += sectionBytes[s] + (s > first);
+    }
+    if (first < sectionBytes.size()) shards.push_back({first, sectionBytes.size()});
+    return shards;
+}
 
-bool PsychConverter::convert(const std::string& p1File,
-                              const std::string& p2File,
-                              const std::string& outFile) {
-    auto startTime = std::chrono::high_resolution_clock::now();
+// ─── planOutput ──────────────────────────────────────────────────────────────
+
+std::vector<PsychConverter::OutputPlan>
+PsychConverter::planOutput(const BuiltChart& chart, const std::string& outFile,
+                           const std::vector<size_t>& sectionBytes,
+                           const std::vector<uint64_t>* storedBytes) const {
+    std::vector<OutputPlan> plans;
+    const size_t sectionCount = chart.sections.size();
+
+    // Compressed output: names are cut from the plain one, then each gets
+    // the codec's extension ("song.json.gz" -> "song-1.json.gz").
+    const std::string packExt = StreamCompressor::extension(m_config.compression);
+    const std::string target  = compressedName(outFile);
+    const std::string plain   = target.substr(0, target.size() - packExt.size());
+
+    size_t      dotPos    = plain.find_last_of('.');
+    std::string baseName  = (dotPos != std::string::npos) ? plain.substr(0, dotPos) : plain;
+    std::string extension = ((dotPos != std::string::npos) ? plain.substr(dotPos) : ".json") + packExt;
+
+    const std::string head = chartHead();
+    const std::string tail = chartTail(chart.finalBPM);
+
+    if (sharding()) {
+        // Shards hold only sections; the song header lives in the manifest,
+        // written last so every shard it lists is already in place.
+        auto shards = shardSections(chart, sectionBytes);
+        const int dp = m_config.decimalPlaces;
+
+        std::string manifest = manifestSong(chart.finalBPM) +
+                               R"(,"sections":)" + std::to_string(sectionCount) +
+                               R"(,"shards":[)";
+
+        for (size_t i = 0; i < shards.size(); ++i) {
+            auto [first, last] = shards[i];
+            OutputPlan plan;
+            plan.name  = baseName + "-" + std::to_string(i + 1) + extension;
+            plan.head  = R"({"firstSection":)" + std::to_string(first) + R"(,"notes":[)";
+            plan.tail  = "]}";
+            plan.first = first;
+            plan.last  = last;
+
+            size_t bytes = plan.head.size() + plan.tail.size() + (last - first - 1);
+            size_t notes = 0;
+            for (size_t s = first; s < last; ++s) {
+                bytes += sectionBytes[s];
+                notes += chart.sections[s].notes.size();
+            }
+            if (storedBytes) bytes = static_cast<size_t>((*storedBytes)[i]);
+
+            std::string file = std::filesystem::path(plan.name).filename().string();
+            if (i > 0) manifest += ',';
+            manifest += R"({"file":")" + file +
+                        R"(","startTime":)" + smartNumToStr(chart.sectionTimes[first], dp) +
+                        R"(,"endTime":)"     + smartNumToStr(chart.sectionTimes[last], dp) +
+                        R"(,"firstSection":)" + std::to_string(first) +
+                        R"(,"sectionCount":)" + std::to_string(last - first) +
+                        R"(,"notes":)"       + std::to_string(notes) +
+                        R"(,"bytes":)"       + std::to_string(bytes) + "}";
+            plans.push_back(std::move(plan));
+        }
+        manifest += "]}";
+        plans.push_back({target, std::move(manifest), "", 0, 0});
+    } else if (m_config.splitOutput && m_config.notesPerSplit > 0) {
+        auto chunks = splitSections(chart.sections, m_config.notesPerSplit);
+        for (size_t i = 0; i < chunks.size(); ++i)
+            plans.push_back({baseName + "-" + std::to_string(i + 1) + extension,
+                             head, tail, chunks[i].first, chunks[i].second});
+    } else {
+        plans.push_back({target, head, tail, 0, sectionCount});
+    }
+    return plans;
+}
 
-    guiLogger.logColored("\n================================================\n", CYAN);
-    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
-    guiLogger.logColored("================================================\n\n",  CYAN);
+std::string PsychConverter::compressedName(const std::string& outFile) const {
+    const std::string ext = StreamCompressor::extension(m_config.compression);
+    if (ext.empty() || (outFile.size() >= ext.size() &&
+                        outFile.compare(outFile.size() - ext.size(), ext.size(), ext) == 0))
+        return outFile;
+    return outFile + ext;
+}
+
+std::string PsychConverter::compressionLine(const CompressionStats& stats, uint64_t storedBytes) const {
+    if (m_config.compression == StreamCompressor::kNone) return {};
+    const int level = m_config.compressionLevel > 0 ? m_config.compressionLevel
+                                                    : StreamCompressor::defaultLevel(m_config.compression);
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "  Compression:   " << StreamCompressor::name(m_config.compression) << " level " << level;
+    if (storedBytes > 0)
+        oss << ", " << (stats.rawBytes / 1024.0) << " KB -> " << (storedBytes / 1024.0) << " KB ("
+            << (static_cast<double>(stats.rawBytes) / storedBytes) << "x)";
+    if (stats.compressNs > 0)
+        oss << ", " << (stats.rawBytes / 1048576.0) / (stats.compressNs * 1e-9) << " MB/s";
+    oss << "\n";
+    return oss.str();
+}
+
+// ─── renderChart ─────────────────────────────────────────────────────────────
+
+std::vector<PsychConverter::OutputFile>
+PsychConverter::renderChart(const BuiltChart& chart, const std::string& outFile,
+                            const std::vector<std::string>& sectionJSON) const {
+    std::vector<size_t> sizes;
+    if (sharding()) {
+        sizes.reserve(sectionJSON.size());
+        for (const auto& part : sectionJSON) sizes.push_back(part.size());
+    }
+
+    std::vector<OutputFile> files;
+    for (auto& plan : planOutput(chart, outFile, sizes)) {
+        size_t size = plan.head.size() + plan.tail.size();
+        for (size_t s = plan.first; s < plan.last; ++s) size += sectionJSON[s].size() + 1;
+
+        std::string json;
+        json.reserve(size);
+        json += plan.head;
+        for (size_t s = plan.first; s < plan.last; ++s) {
+            if (s > plan.first) json += ',';
+            json += sectionJSON[s];
+        }
+        json += plan.tail;
+        files.push_back({std::move(plan.name), std::move(json)});
+    }
+    return files;
+}
+
+// ─── resolveRange ────────────────────────────────────────────────────────────
+
+bool PsychConverter::resolveRange(const std::vector<Input>& inputs,
+                                  uint32_t& startTick, uint32_t& endTick, bool log,
+                                  RangeSpan* span,
+                                  std::vector<std::vector<TempoChange>>* tempoMaps) const {
+    // Timing follows buildChart: the first input's PPQ, and the first tempo
+    // map any input has.
+    std::vector<MIDIParser> scans(inputs.size());
+    const MIDIParser* tempoSrc = nullptr;
+    for (size_t i = 0; i < inputs.size() && !tempoSrc; ++i) {
+        if (!scans[i].parseTempoMap(inputs[i].file)) {
+            guiLogger.logColored("\n[X] Failed to read tempo map of " + inputs[i].file + ": " +
+                                 scans[i].errorMessage + "\n", RED);
+            return false;
+        }
+        if (!scans[i].tempoChanges.empty()) tempoSrc = &scans[i];
+        if (tempoMaps) tempoMaps->push_back(scans[i].tempoChanges);
+    }
+    if (!tempoSrc) tempoSrc = &scans[0];
+
+    const auto& tempoChanges = tempoSrc->tempoChanges;
+    const uint16_t ppq       = scans[0].ppq;
+    const double   finalBPM  = scans[0].bpm * m_config.bpmMultiplier;
+    TempoMap tempoMap(ppq, tempoChanges, m_config.bpmMultiplier);
+
+    double startMs = m_config.rangeStart, endMs = m_config.rangeEnd;
+    int64_t slackNs = 0;
+
+    // Bar n is section n-1 of buildChart's grid.
+    const bool legacy = m_config.legacyTiming;
+    std::vector<std::pair<double, double>> timeToBPM;
+    for (const auto& tc : tempoChanges) {
+        double t = legacy ? ticksToMs(tc.tick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier)
+                          : TempoMap::nsToMs(tempoMap.ticksToNs(tc.tick));
+        timeToBPM.push_back({t, tc.bpm * m_config.bpmMultiplier});
+    }
+    const double slack   = legacy ? 0.0 : 1e-6;
+    const double limitMs = TempoMap::nsToMs(tempoMap.ticksToNs(UINT32_MAX));
+    auto sectionLen = [&](double time) {
+        return (60000.0 / getBPMAtTime(time + slack, timeToBPM, finalBPM)) * 4;
+    };
+
+    if (m_config.rangeInBars) {
+        const long first = std::max(1L, std::lround(m_config.rangeStart));
+        const long last  = std::max(first, std::lround(m_config.rangeEnd));
+
+        double time = 0.0;
+        startMs = endMs = limitMs;
+        for (long bar = 1; bar <= last + 1 && time < limitMs; ++bar) {
+            if (bar == first)    startMs = time;
+            if (bar == last + 1) { endMs = time; break; }
+            time += sectionLen(time);
+        }
+        slackNs = legacy ? 0 : 1;
+    }
+
+    startTick = tempoMap.nsToTick(std::llround(startMs * 1e6) - slackNs);
+    endTick   = tempoMap.nsToTick(std::llround(endMs * 1e6) - slackNs);
+    if (endTick <= startTick) {
+        guiLogger.logColored("\n[X] Range is empty.\n", RED);
+        return false;
+    }
+
+    if (span) {
+        span->startNs = tempoMap.ticksToNs(startTick);
+        span->endNs   = tempoMap.ticksToNs(endTick);
+        // First section ending after the start, up to the first starting at
+        // or after the end (the same walk as the bars above).
+        double time = 0.0;
+        size_t s    = 0;
+        span->firstSection = SIZE_MAX;
+        while (time < limitMs && time < endMs - slack) {
+            double next = time + sectionLen(time);
+            if (span->firstSection == SIZE_MAX && next > startMs + slack) span->firstSection = s;
+            time = next;
+            ++s;
+        }
+        span->endSection   = s;
+        span->firstSection = std::min(span->firstSection, s);
+    }
+
+    if (log) {
+        std::ostringstream msg;
+        msg << std::fixed << std::setprecision(1) << "Range: " << startMs << " ms - " << endMs
+            << " ms (ticks " << startTick << "-" << endTick << ")\n";
+        guiLogger.log(msg.str());
+    }
+    return true;
+}
+
+// ─── parseInputs ─────────────────────────────────────────────────────────────
+
+bool PsychConverter::parseInputs(const std::vector<Input>& inputs, std::vector<MIDIParser>& parsers,
+                                 int minVelocity, bool showProgress, bool parallel) {
+    const size_t n = inputs.size();
+    parsers.clear();
+    parsers.resize(n);
+    if (n == 0) {
+        guiLogger.logColored("\n[X] No input MIDI files!\n", RED);
+        return false;
+    }
 
-    // ── Parallel MIDI parsing ──────────────────────────────────────────────
     ProgressBar parseBar("Parsing MIDI", 40);
     parseBar.setHandle(m_progressHandle);
 
-    MIDIParser p1Parser, p2Parser;
-    std::atomic<int> p1Pct{0}, p2Pct{0};
+    // Per-input percentages; the bar shows their mean.
+    std::vector<std::atomic<int>> pct(n);
+    for (auto& p : pct) p.store(0);
+    std::atomic<size_t> done{0};
+
+    if (showProgress) {
+        for (size_t i = 0; i < n; ++i) {
+            parsers[i].progressCallback = [&, i](double p) {
+                pct[i].store(static_cast<int>(p * 100), std::memory_order_relaxed);
+                int sum = 0;
+                for (const auto& q : pct) sum += q.load(std::memory_order_relaxed);
+                parseBar.update(sum * 0.01 / n, std::to_string(done.load()) + "/" +
+                                std::to_string(n) + " MIDIs | " + std::to_string(sum / n) + "%");
+            };
+        }
+        guiLogger.logColored(parallel ? "Launching parallel MIDI parse threads...\n"
+                                      : "Parsing MIDIs one at a time (memory budget)...\n", YELLOW);
+    }
 
-    p1Parser.progressCallback = [&](double p) {
-        p1Pct.store(static_cast<int>(p * 100), std::memory_order_relaxed);
-        parseBar.update((p1Pct.load() + p2Pct.load()) * 0.005,
-            "P1: " + std::to_string(p1Pct.load()) + "% | P2: " + std::to_string(p2Pct.load()) + "%");
-    };
-    p2Parser.progressCallback = [&](double p) {
-        p2Pct.store(static_cast<int>(p * 100), std::memory_order_relaxed);
-        parseBar.update((p1Pct.load() + p2Pct.load()) * 0.005,
-            "P1: " + std::to_string(p1Pct.load()) + "% | P2: " + std::to_string(p2Pct.load()) + "%");
+    std::vector<MIDIFilter> filters;
+    filters.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        filters.push_back(effectiveFilter(inputs[i].filter, minVelocity));
+        parsers[i].cancelToken = m_cancel;
+    }
+
+    // A windowed parse stops reading a track past the range, so tempo changes
+    // after it (still inside the range's last section) come from the
+    // whole-file scan instead, with or without a seek index.
+    std::vector<std::vector<TempoChange>> tempoMaps;
+    if (m_config.useRange) {
+        uint32_t startTick, endTick;
+        if (!resolveRange(inputs, startTick, endTick, showProgress, nullptr, &tempoMaps))
+            return false;
+
+        // A stale or missing sidecar is rebuilt by this (unseeked) parse.
+        size_t building = 0;
+        for (size_t i = 0; i < n; ++i) {
+            filters[i].startTick = startTick;
+            filters[i].endTick   = endTick;
+            parsers[i].buildSeekIndex = !parsers[i].seekIndex.load(inputs[i].file);
+            building += parsers[i].buildSeekIndex;
+        }
+        if (showProgress)
+            guiLogger.log("Seek index: " + std::to_string(n - building) + " loaded, " +
+                          std::to_string(building) + " building\n");
+    }
+
+    // Worker pool over the inputs; serial runs on this thread alone.
+    std::vector<char>   ok(n, 0);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < n;) {
+            ok[i] = parsers[i].parse(inputs[i].file, m_config.sustainNotes, filters[i]);
+            ++done;
+        }
     };
+    size_t workers = parallel ? std::min<size_t>(n, std::max(2u, std::thread::hardware_concurrency()))
+                              : 1;
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+    // The callbacks reference locals of this function.
+    for (auto& p : parsers) p.progressCallback = nullptr;
+
+    const bool allOk = std::all_of(ok.begin(), ok.end(), [](char c) { return c != 0; });
+    if (!allOk && stopRequested()) {
+        logStopped();
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (!ok[i]) {
+            guiLogger.logColored("\n[X] Failed to parse MIDI file " + inputs[i].file + ": " +
+                                 parsers[i].errorMessage + "\n", RED);
+            return false;
+        }
+    }
 
-    guiLogger.logColored("Launching parallel MIDI parse threads...\n", YELLOW);
+    for (size_t i = 0; i < tempoMaps.size(); ++i) {
+        if (!tempoMaps[i].empty()) parsers[i].bpm = tempoMaps[i].front().bpm;
+        parsers[i].tempoChanges = std::move(tempoMaps[i]);
+    }
+
+    // Best effort: without a sidecar the next range run just rebuilds it.
+    for (size_t i = 0; i < n; ++i)
+        if (parsers[i].buildSeekIndex) parsers[i].seekIndex.save(inputs[i].file);
 
-    auto p1Future = std::async(std::launch::async, [&]() {
-        return p1Parser.parse(p1File, m_config.sustainNotes, m_config.minVelocity);
-    });
-    auto p2Future = std::async(std::launch::async, [&]() {
-        return p2Parser.parse(p2File, m_config.sustainNotes, m_config.minVelocity);
-    });
+    if (!showProgress) return true;
 
-    bool p1Ok = p1Future.get();
-    bool p2Ok = p2Future.get();
+    parseBar.finish(n == 2 ? (parallel ? "Both MIDIs parsed in parallel!" : "Both MIDIs parsed!")
+                           : std::to_string(n) + (parallel ? " MIDIs parsed in parallel!"
+                                                           : " MIDIs parsed!"));
 
-    if (!p1Ok) { guiLogger.logColored("\n[X] Failed to parse P1 MIDI file!\n", RED); return false; }
-    if (!p2Ok) { guiLogger.logColored("\n[X] Failed to parse P2 MIDI file!\n", RED); return false; }
+    int skipped = 0;
+    std::string perInput;
+    for (size_t i = 0; i < n; ++i) {
+        skipped  += parsers[i].skippedTracks;
+        perInput += (i ? ", " : "") + std::to_string(parsers[i].skippedTracks);
+    }
+    if (skipped)
+        guiLogger.log("Tracks skipped by filter: " + perInput + "\n");
+    return true;
+}
 
-    parseBar.finish("Both MIDIs parsed in parallel!");
+// ─── mergeStackedNotes ───────────────────────────────────────────────────────
+
+size_t PsychConverter::mergeStackedNotes(std::vector<ChartNote>& notes, int keyCount) const {
+    // Each lane's cluster anchor: the first note of the current stack.  A
+    // note within dedupMs of its lane's anchor folds into it (longest
+    // sustain and loudest velocity win); anything later starts a new stack.
+    const double eps = m_config.dedupMs;
+    std::vector<size_t> anchor(static_cast<size_t>(keyCount) * 2, SIZE_MAX);
+
+    size_t out = 0;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        int     lane = notes[i].lane;
+        size_t& a    = anchor[lane < 100 ? lane : keyCount + (lane - 100)];
+        if (a != SIZE_MAX && notes[i].time - notes[a].time <= eps) {
+            notes[a].duration = std::max(notes[a].duration, notes[i].duration);
+            notes[a].velocity = std::max(notes[a].velocity, notes[i].velocity);
+            continue;
+        }
+        a = out;
+        notes[out++] = notes[i];
+    }
 
-    // ── Note processing ───────────────────────────────────────────────────
-    ProgressBar convertBar("Converting", 40);
-    convertBar.setHandle(m_progressHandle);
-    convertBar.update(0.0, "Processing notes...");
+    size_t merged = notes.size() - out;
+    notes.erase(notes.begin() + static_cast<std::ptrdiff_t>(out), notes.end());
+    return merged;
+}
 
-    uint16_t ppq      = p1Parser.ppq;
-    double   baseBPM  = p1Parser.bpm;
-    double   finalBPM = baseBPM * m_config.bpmMultiplier;
+// ─── thinNotes ───────────────────────────────────────────────────────────────
 
-    auto& tempoChanges = !p1Parser.tempoChanges.empty()
-                         ? p1Parser.tempoChanges : p2Parser.tempoChanges;
+void PsychConverter::thinNotes(std::vector<ChartNote>& notes, int keyCount,
+                               std::vector<double>& removedTimes) const {
+    std::vector<uint8_t> keep(notes.size(), 1);
+
+    // Pass 1 – per-lane minimum gap.  A note too close to the lane's last
+    // kept note replaces it only if louder; the note before that one is
+    // already a full gap earlier, so the lane stays valid.
+    if (m_config.minLaneGapMs > 0.0) {
+        const double gap = m_config.minLaneGapMs;
+        std::vector<size_t> lastKept(static_cast<size_t>(keyCount) * 2, SIZE_MAX);
+        for (size_t i = 0; i < notes.size(); ++i) {
+            int     lane = notes[i].lane;
+            size_t& last = lastKept[lane < 100 ? lane : keyCount + (lane - 100)];
+            if (last != SIZE_MAX && notes[i].time - notes[last].time < gap) {
+                if (notes[i].velocity <= notes[last].velocity) { keep[i] = 0; continue; }
+                keep[last] = 0;
+            }
+            last = i;
+        }
+    }
+
+    // Pass 2 – sliding window of npsWindowMs over the kept notes.  Kept
+    // notes in the window are bucketed by velocity (time-ordered); while the
+    // window holds more than the budget the newest note of the quietest
+    // bucket goes, so earlier and louder notes win and the result is
+    // deterministic.  Buckets only lose notes from the front (expiry) or the
+    // back (thinning), so each step is O(1).
+    if (m_config.maxNPS > 0) {
+        const double window = m_config.npsWindowMs;
+        const size_t budget = std::max<size_t>(1, static_cast<size_t>(
+            static_cast<double>(m_config.maxNPS) * window / 1000.0));
+
+        std::vector<std::deque<size_t>> buckets(128);
+        uint64_t nonEmpty[2] = {0, 0};   // bit v set = buckets[v] non-empty
+        std::deque<size_t> inWindow;      // admitted notes, time order (may hold dropped ones)
+        size_t count = 0;
+
+        auto setBit = [&](uint8_t v, bool on) {
+            uint64_t bit = uint64_t(1) << (v & 63);
+            if (on) nonEmpty[v >> 6] |= bit; else nonEmpty[v >> 6] &= ~bit;
+        };
+
+        for (size_t i = 0; i < notes.size(); ++i) {
+            if (!keep[i]) continue;
+            const double t = notes[i].time;
+
+            while (!inWindow.empty() && notes[inWindow.front()].time <= t - window) {
+                size_t old = inWindow.front();
+                inWindow.pop_front();
+                if (!keep[old]) continue;
+                auto& b = buckets[notes[old].velocity & 127];
+                b.pop_front();
+                if (b.empty()) setBit(notes[old].velocity & 127, false);
+                --count;
+            }
+
+            uint8_t v = notes[i].velocity & 127;
+            buckets[v].push_back(i);
+            setBit(v, true);
+            inWindow.push_back(i);
+            ++count;
+
+            if (count > budget) {
+                int lowest = nonEmpty[0] ? __builtin_ctzll(nonEmpty[0])
+                                         : 64 + __builtin_ctzll(nonEmpty[1]);
+                auto& b = buckets[lowest];
+                keep[b.back()] = 0;
+                b.pop_back();
+                if (b.empty()) setBit(static_cast<uint8_t>(lowest), false);
+                --count;
+            }
+        }
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        if (keep[i]) notes[out++] = notes[i];
+        else         removedTimes.push_back(notes[i].time);
+    }
+    notes.erase(notes.begin() + static_cast<std::ptrdiff_t>(out), notes.end());
+}
+
+// ─── buildChart ──────────────────────────────────────────────────────────────
+
+PsychConverter::BuiltChart PsychConverter::buildChart(const std::vector<Input>& inputs,
+                                                      const std::vector<MIDIParser>& parsers,
+                                                      ProgressBar* bar) const {
+    auto progress = [bar](double p, const std::string& status) {
+        if (bar) bar->update(p, status);
+    };
+    progress(0.0, "Processing notes...");
+
+    BuiltChart chart;
+
+    if (parsers.empty()) return chart;
+    uint16_t ppq      = parsers[0].ppq;
+    double   baseBPM  = parsers[0].bpm;
+    double   finalBPM = baseBPM * m_config.bpmMultiplier;
+    chart.finalBPM    = finalBPM;
+
+    // The first tempo map any input has.
+    const MIDIParser* tempoSrc = &parsers[0];
+    for (const auto& p : parsers)
+        if (!p.tempoChanges.empty()) { tempoSrc = &p; break; }
+    auto& tempoChanges = tempoSrc->tempoChanges;
+
+    // Fixed-point tick → ns timing by default; legacyTiming reproduces the
+    // original per-note double arithmetic for existing charts.
+    const bool    legacy   = m_config.legacyTiming;
+    const int64_t offsetNs = std::llround(m_config.noteOffset * 1e6);
+    TempoMap      tempoMap(ppq, tempoChanges, m_config.bpmMultiplier);
+
+    auto tickToMs = [&](uint32_t tick) {
+        return legacy ? ticksToMs(tick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier)
+                      : TempoMap::nsToMs(tempoMap.ticksToNs(tick));
+    };
 
     std::vector<std::pair<double, double>> timeToBPM;
     for (const auto& tc : tempoChanges) {
-        double t = ticksToMs(tc.tick, baseBPM, ppq, tempoChanges, m_config.bpmMultiplier);
-        timeToBPM.push_back({t, tc.bpm * m_config.bpmMultiplier});
+        timeToBPM.push_back({tickToMs(tc.tick), tc.bpm * m_config.bpmMultiplier});
     }
 
+    // Every decoded note becomes at most one chart note: reserve exactly.
+    size_t decoded = 0, totalTracks = 0;
+    for (const auto& p : parsers) {
+        for (const auto& track : p.tracks) decoded += track.size();
+        totalTracks += p.tracks.size();
+    }
     std::vector<ChartNote> allNotes;
-    allNotes.reserve(50000);
+    allNotes.reserve(decoded);
+    chart.noteBytes = allNotes.capacity() * sizeof(ChartNote);
     uint32_t maxTick = 0;
 
     // Determine key count: keyCount = mania + 1 (mania=3 is default 4-key)
     int keyCount = m_config.mania + 1;
-
-    // P1 tracks → lanes 0 to (keyCount-1)
-    size_t totalP1 = p1Parser.tracks.size(), doneP1 = 0;
-    for (const auto& track : p1Parser.tracks) {
-        for (const auto& evt : track) {
-            double ms = ticksToMs(evt.tick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier)
-                        + m_config.noteOffset;
-            double dur = 0.0;
-            if (m_config.sustainNotes && evt.duration > 0) {
-                double s = ticksToMs(evt.tick,              finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
-                double e = ticksToMs(evt.tick + evt.duration, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
-                dur = e - s;
+    const LaneMap::Table baseLanes = m_config.laneMap.compile(keyCount);
+
+    // Notes were parsed with the loosest velocity of every chart sharing them.
+    const uint8_t minVel = static_cast<uint8_t>(m_config.minVelocity);
+
+    // Timing mode and sustain are template parameters of the note loop,
+    // dispatched once below, so the per-note path tests neither.
+    auto collect = [&](auto legacyC, auto sustainC) -> bool {
+        constexpr bool kLegacy  = decltype(legacyC)::value;
+        constexpr bool kSustain = decltype(sustainC)::value;
+
+        auto addTrack = [&](const std::vector<MIDINote>& track, const LaneMap::Table& lanes,
+                            int laneBase) {
+            for (const auto& evt : track) {
+                int lane = lanes[evt.note & 127];
+                if (evt.velocity < minVel || lane == LaneMap::kDrop) continue;
+                double ms, dur = 0.0;
+                if constexpr (kLegacy) {
+                    double s = ticksToMs(evt.tick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
+                    ms = s + m_config.noteOffset;
+                    if (kSustain && evt.duration > 0)
+                        dur = ticksToMs(evt.tick + evt.duration, finalBPM, ppq, tempoChanges,
+                                        m_config.bpmMultiplier) - s;
+                } else {
+                    int64_t startNs = tempoMap.ticksToNs(evt.tick);
+                    ms = TempoMap::nsToMs(startNs + offsetNs);
+                    if (kSustain && evt.duration > 0)
+                        dur = TempoMap::nsToMs(tempoMap.ticksToNs(evt.tick + evt.duration) - startNs);
+                }
+                allNotes.emplace_back(ms, lane + laneBase, dur, evt.velocity);
+                maxTick = std::max(maxTick, evt.tick);
             }
-            allNotes.emplace_back(ms, evt.note % keyCount, dur);
-            maxTick = std::max(maxTick, evt.tick);
-        }
-        ++doneP1;
-        if (totalP1 > 0)
-            convertBar.update(static_cast<double>(doneP1) / totalP1 * 0.25,
-                "P1 tracks " + std::to_string(doneP1) + "/" + std::to_string(totalP1));
-    }
-
-    convertBar.update(0.25, "Processing P2...");
-    size_t p1Count = allNotes.size();
-
-    // P2 tracks → lanes (keyCount) to (2*keyCount-1), stored as +100 temporarily for differentiation
-    size_t totalP2 = p2Parser.tracks.size(), doneP2 = 0;
-    for (const auto& track : p2Parser.tracks) {
-        for (const auto& evt : track) {
-            double ms = ticksToMs(evt.tick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier)
-                        + m_config.noteOffset;
-            double dur = 0.0;
-            if (m_config.sustainNotes && evt.duration > 0) {
-                double s = ticksToMs(evt.tick,              finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
-                double e = ticksToMs(evt.tick + evt.duration, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
-                dur = e - s;
+        };
+
+        // P1 inputs → lanes 0 to (keyCount-1); P2 inputs → lanes (keyCount)
+        // to (2*keyCount-1), stored as +100 until sections assign sides.
+        // Inputs are taken in order, so notes at one time keep input order
+        // into the sort.
+        size_t doneTracks = 0;
+        for (size_t in = 0; in < inputs.size() && in < parsers.size(); ++in) {
+            const bool p1       = inputs[in].player == 1;
+            const int  laneBase = p1 ? 0 : 100;
+
+            // The input's lane shift folded into its own copy of the table.
+            LaneMap::Table lanes = baseLanes;
+            const int shift = (inputs[in].laneOffset % keyCount + keyCount) % keyCount;
+            if (shift != 0)
+                for (auto& l : lanes)
+                    if (l != LaneMap::kDrop) l = static_cast<int8_t>((l + shift) % keyCount);
+
+            const size_t before = allNotes.size();
+            for (const auto& track : parsers[in].tracks) {
+                if (stopRequested()) return false;
+                addTrack(track, lanes, laneBase);
+                ++doneTracks;
+                progress(static_cast<double>(doneTracks) / totalTracks * 0.5,
+                    "Tracks " + std::to_string(doneTracks) + "/" + std::to_string(totalTracks));
             }
-            allNotes.emplace_back(ms, (evt.note % keyCount) + 100, dur);
-            maxTick = std::max(maxTick, evt.tick);
+            if (p1) chart.p1Notes += allNotes.size() - before;
         }
-        ++doneP2;
-        if (totalP2 > 0)
-            convertBar.update(0.25 + static_cast<double>(doneP2) / totalP2 * 0.25,
-                "P2 tracks " + std::to_string(doneP2) + "/" + std::to_string(totalP2));
-    }
+        return true;
+    };
+
+    using On  = std::true_type;
+    using Off = std::false_type;
+    const bool sustain = m_config.sustainNotes;
+    bool collected = legacy ? (sustain ? collect(On{},  On{}) : collect(On{},  Off{}))
+                            : (sustain ? collect(Off{}, On{}) : collect(Off{}, Off{}));
+    if (!collected) return chart;
+    chart.totalNotes = allNotes.size();
 
-    convertBar.update(0.50, "Sorting notes...");
+    if (stopRequested()) return chart;
+    progress(0.50, "Sorting notes...");
 
     if (allNotes.size() > 10000) {
-        guiLogger.logColored("Using parallel sort for large dataset...\n", YELLOW);
+        if (bar) guiLogger.logColored("Using parallel sort for large dataset...\n", YELLOW);
         std::sort(std::execution::par_unseq, allNotes.begin(), allNotes.end(),
             [](const ChartNote& a, const ChartNote& b) {
                 return a.time < b.time || (a.time == b.time && a.lane < b.lane);
@@ -277,21 +771,55 @@ bool PsychConverter::convert(const std::string& p1File,
             });
     }
 
-    convertBar.update(0.75, "Building sections...");
+    // Stacked-note merge, then density limits, on the sorted notes.
+    const bool dedup = m_config.dedupMs >= 0.0;
+    const bool thin  = m_config.maxNPS > 0 || m_config.minLaneGapMs > 0.0;
+    std::vector<double> thinnedTimes;
+    if (dedup) {
+        if (stopRequested()) return chart;
+        progress(0.65, "Merging stacked notes...");
+        chart.mergedNotes = mergeStackedNotes(allNotes, keyCount);
+    }
+    if (thin) {
+        if (stopRequested()) return chart;
+        progress(0.70, "Thinning notes...");
+        thinNotes(allNotes, keyCount, thinnedTimes);
+        chart.thinnedNotes = thinnedTimes.size();
+    }
+    if (dedup || thin) {
+        chart.totalNotes = allNotes.size();
+        chart.p1Notes    = static_cast<size_t>(std::count_if(allNotes.begin(), allNotes.end(),
+                               [](const ChartNote& n) { return n.lane < 100; }));
+    }
+
+    if (stopRequested()) return chart;
+    progress(0.75, "Building sections...");
 
     // ── Section building (two-pointer O(n)) ──────────────────────────────
-    std::vector<Section> sections;
-    double maxTime    = ticksToMs(maxTick, finalBPM, ppq, tempoChanges, m_config.bpmMultiplier);
+    std::vector<Section>& sections = chart.sections;
+    double maxTime    = tickToMs(maxTick);
     double currentTime = 0.0;
     double currentBPM  = finalBPM;
 
+    // The section grid is accumulated in doubles; fixed-point note and tempo
+    // times land within half a nanosecond of it, so treat 1 ns as "on" a line.
+    const double slack = legacy ? 0.0 : 1e-6;
+
     int    totalSectionEst = static_cast<int>((maxTime / ((60000.0 / finalBPM) * 4)) + 1);
     int    sectionCount    = 0;
     size_t noteIdx         = 0;
+    size_t thinnedIdx      = 0;
     bool   lastMustHit     = true;
 
+    // Sustain overlap: each lane's (per side) last hold as (section, note);
+    // section == sections.size() is the section being built.
+    const bool   resolveHolds = m_config.sustainNotes && m_config.sustainOverlap != 0;
+    const double holdGap      = m_config.sustainGapMs;
+    struct HoldRef { size_t section = SIZE_MAX, note = 0; };
+    std::vector<HoldRef> lastHold(resolveHolds ? static_cast<size_t>(keyCount) * 2 : 0);
+
     while (currentTime < maxTime + (60000.0 / currentBPM) * 4) {
-        currentBPM = getBPMAtTime(currentTime, timeToBPM, finalBPM);
+        currentBPM = getBPMAtTime(currentTime + slack, timeToBPM, finalBPM);
         double sectionLen = (60000.0 / currentBPM) * 4;
         double sectionEnd = currentTime + sectionLen;
 
@@ -303,17 +831,17 @@ bool PsychConverter::convert(const std::string& p1File,
         double lastBPMInSection = currentBPM;
         bool   foundChange      = false;
         for (const auto& [t, b] : timeToBPM) {
-            if (t > currentTime && t < sectionEnd) { foundChange = true; lastBPMInSection = b; }
+            if (t > currentTime + slack && t < sectionEnd - slack) { foundChange = true; lastBPMInSection = b; }
         }
         if (foundChange) { section.changeBPM = true; section.bpm = lastBPMInSection; }
 
         // Two-pointer: skip any notes before currentTime
-        while (noteIdx < allNotes.size() && allNotes[noteIdx].time < currentTime)
+        while (noteIdx < allNotes.size() && allNotes[noteIdx].time < currentTime - slack)
             ++noteIdx;
 
         size_t sectionStart = noteIdx;
         size_t sectionEnd2  = noteIdx;
-        while (sectionEnd2 < allNotes.size() && allNotes[sectionEnd2].time < sectionEnd)
+        while (sectionEnd2 < allNotes.size() && allNotes[sectionEnd2].time < sectionEnd - slack)
             ++sectionEnd2;
 
         int p1Count2 = 0, p2Count2 = 0;
@@ -333,79 +861,429 @@ bool PsychConverter::convert(const std::string& p1File,
             int  finalLane    = section.mustHitSection
                                 ? (isP1 ? baseLane : baseLane + keyCount)
                                 : (isP1 ? baseLane + keyCount : baseLane);
+
+            if (resolveHolds) {
+                HoldRef& h = lastHold[isP1 ? baseLane : keyCount + baseLane];
+                if (h.section != SIZE_MAX) {
+                    ChartNote& prev = h.section == sections.size() ? section.notes[h.note]
+                                                                   : sections[h.section].notes[h.note];
+                    // A hold ending exactly where the next note starts (to
+                    // the nanosecond) is legato, not an overlap.
+                    double room = note.time - holdGap - prev.time;
+                    if (prev.duration > room + 1e-6) {
+                        prev.duration = (m_config.sustainOverlap == 1 && room > 0.0) ? room : 0.0;
+                        ++chart.resolvedHolds;
+                    }
+                }
+                h = note.duration > 0.0 ? HoldRef{sections.size(), section.notes.size()} : HoldRef{};
+            }
+
             section.notes.emplace_back(note.time, finalLane, note.duration);
         }
 
         noteIdx = sectionEnd2;
+
+        size_t thinned = 0;
+        while (thinnedIdx < thinnedTimes.size() && thinnedTimes[thinnedIdx] < sectionEnd - slack) {
+            ++thinnedIdx;
+            ++thinned;
+        }
+        if (!thinnedTimes.empty()) chart.thinnedPerSection.push_back(thinned);
+
+        chart.sectionTimes.push_back(currentTime);
         sections.push_back(std::move(section));
         currentTime += sectionLen;
 
+        if ((sectionCount & 63) == 63 && stopRequested()) return chart;
+
         if (++sectionCount % 10 == 0) {
             double prog = std::min(0.99, currentTime / maxTime);
-            convertBar.update(0.75 + prog * 0.24,
+            progress(0.75 + prog * 0.24,
                 "Section " + std::to_string(sectionCount) + "/" + std::to_string(totalSectionEst));
         }
     }
 
+    chart.sectionTimes.push_back(currentTime);
+
     // Drop trailing empty sections
     while (!sections.empty() && sections.back().notes.empty())
         sections.pop_back();
+    chart.sectionTimes.resize(sections.size() + 1);
+    if (!thinnedTimes.empty()) chart.thinnedPerSection.resize(sections.size());
 
-    convertBar.finish("Sections built!");
+    return chart;
+}
 
-    // ── File output ───────────────────────────────────────────────────────
-    std::vector<std::string> outputFiles;
-    size_t totalFileSize = 0;
+// ─── writeFiles ──────────────────────────────────────────────────────────────
+
+bool PsychConverter::writeFiles(const std::vector<OutputFile>& files) const {
+    std::vector<std::string> names;
+    for (const auto& file : files) names.push_back(file.name);
+
+    OutputWriter writer(std::move(names));
+    writer.setCompression(m_config.compression, m_config.compressionLevel);
+    for (size_t i = 0; i < files.size(); ++i) {
+        const std::string& json = files[i].json;
+        if (!writer.open(i, json.size())) break;
+        for (size_t done = 0; done < json.size(); done += kOutputBuffer) {
+            if (stopRequested()) return false;
+            if (!writer.write(i, json.data() + done, std::min(kOutputBuffer, json.size() - done)))
+                break;
+        }
+        if (!writer.close(i)) break;
+    }
+    if (stopRequested()) return false;
 
-    if (m_config.splitOutput && m_config.notesPerSplit > 0) {
-        guiLogger.logColored("Splitting chart into multiple files...\n", CYAN);
+    if (!writer.errorMessage.empty() || !writer.commit()) {
+        guiLogger.logColored("\n[X] Failed to write file: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+    return true;
+}
 
-        auto chunks = splitSections(sections, m_config.notesPerSplit);
+// ─── writeChart ──────────────────────────────────────────────────────────────
+
+bool PsychConverter::writeChart(const BuiltChart& chart, const std::string& outFile,
+                                std::vector<std::string>& outputFiles, size_t& totalFileSize,
+                                bool lowMemory, size_t* heldBytes, CompressionStats* packed) const {
+    if (m_config.binaryOutput) {
+        guiLogger.logColored("Writing binary chart...\n", CYAN);
+        ChartData meta;
+        meta.songName  = m_config.songName;
+        meta.player1   = m_config.p1Char;
+        meta.player2   = m_config.p2Char;
+        meta.gfVersion = m_config.gfChar;
+        meta.stage     = m_config.stage;
+        meta.bpm       = chart.finalBPM;
+        meta.speed     = m_config.speed;
+        meta.mania     = m_config.mania;
+        std::string error;
+        uint64_t    bytes = 0;
+        if (!BinaryChart::write(outFile, meta, chart.sections, chart.sectionTimes, error, &bytes)) {
+            if (!stopRequested())
+                guiLogger.logColored("\n[X] Failed to write file: " + error + "\n", RED);
+            return false;
+        }
+        outputFiles.push_back(outFile);
+        totalFileSize += static_cast<size_t>(bytes);
+        if (heldBytes) *heldBytes = 2 * kOutputBuffer;
+        return true;
+    }
 
-        size_t      dotPos    = outFile.find_last_of('.');
-        std::string baseName  = (dotPos != std::string::npos) ? outFile.substr(0, dotPos) : outFile;
-        std::string extension = (dotPos != std::string::npos) ? outFile.substr(dotPos)    : ".json";
+    const bool split = sharding() || (m_config.splitOutput && m_config.notesPerSplit > 0);
+    if (!lowMemory)
+        guiLogger.logColored(sharding() ? "Sharding chart with a manifest...\n"
+                             : split    ? "Splitting chart into multiple files...\n"
+                                        : "Generating single JSON file...\n", CYAN);
+
+    const SectionWriter write = sectionWriter();
+    const SectionFormat fmt   = sectionFormat();
+    const size_t sectionCount = chart.sections.size();
+
+    // Shard cuts depend on serialised sizes, so sections are serialised up
+    // front: kept for the write, or on a memory budget only measured and
+    // serialised again as they are written.
+    std::vector<std::string> parts;
+    std::vector<size_t>      sizes;
+    size_t                   partBytes = 0;
+    if (sharding()) {
+        std::string buf;
+        if (!lowMemory) parts.resize(sectionCount);
+        sizes.reserve(sectionCount);
+        for (size_t i = 0; i < sectionCount; ++i) {
+            if ((i & 255) == 255 && stopRequested()) return false;
+            std::string& out = lowMemory ? buf : parts[i];
+            out.clear();
+            write(out, chart.sections[i], fmt);
+            sizes.push_back(out.size());
+            partBytes += out.capacity();
+        }
+        if (lowMemory) partBytes = buf.capacity();
+    }
 
-        for (size_t i = 0; i < chunks.size(); ++i) {
-            std::string fname = baseName + "-" + std::to_string(i + 1) + extension;
-            std::string json  = buildJSON(chunks[i], finalBPM);
+    std::vector<OutputPlan> plans = planOutput(chart, outFile, sizes);
+    std::vector<std::string> names;
+    for (const auto& plan : plans) names.push_back(plan.name);
+    OutputWriter writer(std::move(names), kOutputBuffer);
+    writer.setCompression(m_config.compression, m_config.compressionLevel);
+
+    // One producer per file: serialises its sections into the writer's fill
+    // buffer while the I/O thread writes (and compresses) the previous one.
+    auto produce = [&](size_t f) {
+        const OutputPlan& plan = plans[f];
+        size_t hint = plan.head.size() + plan.tail.size();
+        for (size_t s = plan.first; s < plan.last; ++s)
+            hint += 1 + (sizes.empty() ? chart.sections[s].notes.size() * 32 + 110 : sizes[s]);
+        if (!writer.open(f, hint)) return false;
+
+        std::string& buf = writer.buffer(f);
+        buf += plan.head;
+        for (size_t s = plan.first; s < plan.last; ++s) {
+            if ((s & 255) == 255 && stopRequested()) return false;
+            if (s > plan.first) buf += ',';
+            if (parts.empty()) write(buf, chart.sections[s], fmt);
+            else               buf += parts[s];
+            if (!writer.flush(f)) return false;
+        }
+        buf += plan.tail;
+        return writer.close(f);
+    };
 
-            std::ofstream out(fname);
-            if (!out) {
-                guiLogger.logColored("\n[X] Failed to write file: " + fname + "\n", RED);
-                return false;
-            }
-            out << json;
-            outputFiles.push_back(fname);
-            totalFileSize += json.size();
+    // A compressed shard's size is only known once it is written, so their
+    // manifest is planned again from the stored sizes and written after them.
+    const size_t pooled = plans.size() - (manifestLast() ? 1 : 0);
+    std::atomic<size_t> next{0};
+    std::atomic<bool>   failed{false};
+    auto producer = [&]() {
+        for (size_t f; !failed && (f = next++) < pooled;)
+            if (!produce(f)) failed = true;
+    };
+    size_t producers = lowMemory ? 1 : std::min<size_t>(pooled,
+                                   std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < producers; ++i) pool.emplace_back(producer);
+    producer();
+    for (auto& t : pool) t.join();
+    if (!failed && pooled < plans.size()) {
+        std::vector<uint64_t> stored;
+        for (size_t i = 0; i < pooled; ++i) stored.push_back(writer.size(i));
+        plans.back() = planOutput(chart, outFile, sizes, &stored).back();
+        if (!produce(pooled)) failed = true;
+    }
+
+    if (stopRequested()) return false;
+    if (failed || !writer.commit()) {
+        guiLogger.logColored("\n[X] Failed to write file: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+
+    if (heldBytes) *heldBytes = partBytes + writer.peakBufferBytes();
+    if (packed) packed->compressNs += writer.compressNs();
+    for (size_t i = 0; i < plans.size(); ++i) {
+        size_t bytes = static_cast<size_t>(writer.size(i));
+        outputFiles.push_back(plans[i].name);
+        totalFileSize += bytes;
+        if (packed) packed->rawBytes += writer.rawSize(i);
+        if (split)
+            guiLogger.log("  Created: " + plans[i].name + " (" +
+                          std::to_string(bytes / 1024.0) + " KB)\n");
+    }
+    return true;
+}
 
-            guiLogger.log("  Created: " + fname + " (" +
-                          std::to_string(json.size() / 1024.0) + " KB)\n");
+// ─── logThinning ─────────────────────────────────────────────────────────────
+
+void PsychConverter::logThinning(const BuiltChart& chart) const {
+    size_t sectionsHit = 0;
+    for (size_t n : chart.thinnedPerSection) sectionsHit += (n > 0);
+
+    guiLogger.log("Thinned " + std::to_string(chart.thinnedNotes) + " notes in " +
+                  std::to_string(sectionsHit) + " sections:\n");
+    size_t shown = 0;
+    for (size_t s = 0; s < chart.thinnedPerSection.size() && shown < 5; ++s) {
+        if (chart.thinnedPerSection[s] == 0) continue;
+        std::ostringstream ts;
+        ts << "  Section " << std::setw(5) << s << ": -" << chart.thinnedPerSection[s]
+           << " (" << chart.sections[s].notes.size() << " kept)\n";
+        guiLogger.log(ts.str());
+        ++shown;
+    }
+    if (sectionsHit > shown)
+        guiLogger.log("  ... and " + std::to_string(sectionsHit - shown) + " more\n");
+    guiLogger.log("\n");
+}
+
+// ─── Metadata fast path ──────────────────────────────────────────────────────
+
+uint64_t PsychConverter::sourceHash(const std::vector<Input>& inputs) const {
+    // No text metadata to patch in place.
+    if (m_config.binaryOutput || m_config.compression != StreamCompressor::kNone) return 0;
+
+    uint64_t h = ChartFingerprint::hash(nullptr, 0);
+    auto mix    = [&h](const auto& v) { h = ChartFingerprint::hash(&v, sizeof(v), h); };
+    auto mixStr = [&](const std::string& str) {
+        mix(str.size());
+        h = ChartFingerprint::hash(str.data(), str.size(), h);
+    };
+
+    mix(inputs.size());
+    for (const Input& in : inputs) {
+        uint64_t size;
+        int64_t  mtime;
+        if (!ChartFingerprint::stamp(in.file, size, mtime)) return 0;
+        std::error_code ec;
+        mixStr(std::filesystem::absolute(in.file, ec).string());
+        mix(size);
+        mix(mtime);
+        mix(in.player);
+        mix(in.laneOffset);
+    }
+
+    // Every option that can change a note byte.  Song name, characters,
+    // stage and speed only reach the metadata; maxMemoryBytes changes how
+    // the JSON is written, not what.
+    const Config& c = m_config;
+    mix(c.bpmMultiplier);  mix(c.noteOffset);     mix(c.minVelocity);   mix(c.decimalPlaces);
+    mix(c.mania);          mix(c.laneMap.compile(c.mania + 1));
+    mix(c.highPrecision);  mix(c.sustainNotes);   mix(c.splitOutput);   mix(c.notesPerSplit);
+    mix(c.minifyJSON);     mix(c.roundTimesTo);   mix(c.legacyTiming);
+    for (const Input& in : inputs) {
+        const MIDIFilter& f = in.filter;
+        mix(f.tracks.size());
+        for (int t : f.tracks) mix(t);
+        mix(f.trackNames.size());
+        for (const auto& name : f.trackNames) mixStr(name);
+        mix(f.channelMask);   mix(f.minPitch);     mix(f.maxPitch);
+        mix(f.minVelocity);   mix(f.maxVelocity);  mix(f.startTick);     mix(f.endTick);
+    }
+    mix(c.sustainOverlap); mix(c.sustainGapMs);   mix(c.dedupMs);
+    mix(c.maxNPS);         mix(c.npsWindowMs);    mix(c.minLaneGapMs);
+    mix(c.shardBytes);     mix(c.shardMs);
+    mix(c.useRange);       mix(c.rangeInBars);    mix(c.rangeStart);    mix(c.rangeEnd);
+    return h ? h : 1;
+}
+
+void PsychConverter::saveFingerprint(const std::string& outFile, uint64_t hash, double finalBPM,
+                                     const std::vector<std::string>& outputFiles) const {
+    if (hash == 0) return;
+    ChartFingerprint fp;
+    fp.sourceHash = hash;
+    fp.finalBPM   = finalBPM;
+    for (size_t i = 0; i < outputFiles.size(); ++i) {
+        auto meta = fileMetadata(i, outputFiles.size(), finalBPM);
+        ChartFingerprint::File f;
+        f.name     = std::filesystem::path(outputFiles[i]).filename().string();
+        f.metaHead = static_cast<uint32_t>(meta.first.size());
+        f.metaTail = static_cast<uint32_t>(meta.second.size());
+        fp.files.push_back(std::move(f));
+    }
+    fp.save(outFile);   // best effort: without it the next run converts in full
+}
+
+bool PsychConverter::patchMetadata(const std::string& outFile, uint64_t hash) const {
+    ChartFingerprint fp;
+    if (hash == 0 || !fp.load(outFile) || fp.sourceHash != hash) return false;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    guiLogger.logColored("Inputs and note options unchanged: patching song metadata only\n", CYAN);
+
+    auto fallBack = [&](const std::string& reason) {
+        if (!stopRequested())
+            guiLogger.logColored("  " + reason + "; converting in full\n", YELLOW);
+        return false;
+    };
+
+    // Files whose metadata bytes differ from what this config writes.
+    struct Patch {
+        size_t      file;
+        std::string head, tail;
+    };
+    std::vector<Patch>       patches;
+    std::vector<std::string> names;
+    const size_t fileCount = fp.files.size();
+    for (size_t i = 0; i < fileCount; ++i) {
+        const ChartFingerprint::File& f = fp.files[i];
+        auto meta = fileMetadata(i, fileCount, fp.finalBPM);
+        if (meta.first.empty() && meta.second.empty()) {
+            if (f.metaHead || f.metaTail) return fallBack("Output layout changed");
+            continue;
         }
-    } else {
-        guiLogger.logColored("Generating single JSON file...\n", CYAN);
-        std::string json = buildJSON(sections, finalBPM);
 
-        std::ofstream out(outFile);
-        if (!out) {
-            guiLogger.logColored("\n[X] Failed to write output file!\n", RED);
-            return false;
+        const std::string path = ChartFingerprint::pathOf(outFile, f.name);
+        std::ifstream in(path, std::ios::binary);
+        std::string oldHead(f.metaHead, '\0'), oldTail(f.metaTail, '\0');
+        in.read(&oldHead[0], f.metaHead);
+        in.seekg(static_cast<std::streamoff>(f.size - f.metaTail));
+        in.read(&oldTail[0], f.metaTail);
+        if (!in) return fallBack("Cannot read " + path);
+
+        if (oldHead != meta.first || oldTail != meta.second) {
+            patches.push_back({i, std::move(meta.first), std::move(meta.second)});
+            names.push_back(path);
         }
-        out << json;
-        outputFiles.push_back(outFile);
-        totalFileSize = json.size();
     }
 
-    // ── Stats ─────────────────────────────────────────────────────────────
-    auto endTime = std::chrono::high_resolution_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+    // The notes between the old metadata are copied byte for byte.
+    OutputWriter writer(names, kOutputBuffer);
+    std::string chunk(kOutputBuffer, '\0');
+    for (size_t k = 0; k < patches.size(); ++k) {
+        const Patch&                  p = patches[k];
+        const ChartFingerprint::File& f = fp.files[p.file];
+        uint64_t body = f.size - f.metaHead - f.metaTail;
+
+        std::ifstream in(names[k], std::ios::binary);
+        in.seekg(f.metaHead);
+        if (!in || !writer.open(k, p.head.size() + body + p.tail.size()) ||
+            !writer.write(k, p.head.data(), p.head.size()))
+            return fallBack("Cannot patch " + names[k]);
+        while (body > 0) {
+            if (stopRequested()) return false;
+            size_t n = static_cast<size_t>(std::min<uint64_t>(body, chunk.size()));
+            if (!in.read(&chunk[0], static_cast<std::streamsize>(n)) || !writer.write(k, chunk.data(), n))
+                return fallBack("Cannot patch " + names[k]);
+            body -= n;
+        }
+        if (!writer.write(k, p.tail.data(), p.tail.size()) || !writer.close(k))
+            return fallBack("Cannot patch " + names[k]);
+    }
+    if (stopRequested()) return false;
+    if (!writer.commit()) return fallBack("Cannot patch " + writer.errorMessage);
 
-    guiLogger.logColored("\n=== CONVERSION SUCCESSFUL ===\n\n", GREEN);
-    guiLogger.log("Chart Statistics:\n");
-    guiLogger.log("  Total Notes:   " + std::to_string(allNotes.size()) + "\n");
-    guiLogger.log("  P1 Notes:      " + std::to_string(p1Count) + "\n");
-    guiLogger.log("  P2 Notes:      " + std::to_string(allNotes.size() - p1Count) + "\n");
-    guiLogger.log("  Sections:      " + std::to_string(sections.size()) + "\n\n");
+    for (const Patch& p : patches) {
+        fp.files[p.file].metaHead = static_cast<uint32_t>(p.head.size());
+        fp.files[p.file].metaTail = static_cast<uint32_t>(p.tail.size());
+    }
+    fp.save(outFile);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+    guiLogger.logColored("\n=== METADATA UPDATED ===\n\n", GREEN);
+    std::ostringstream oss;
+    oss << "Output:\n";
+    oss << "  Files Patched: " << patches.size() << " of " << fileCount << "\n";
+    oss << "  Process Time:  " << elapsed.count() << " ms\n";
+    oss << "  Location:      " << outFile << "\n\n";
+    guiLogger.log(oss.str());
+    return true;
+}
+
+// ─── Memory accounting ───────────────────────────────────────────────────────
+
+size_t PsychConverter::sectionBytes(const std::vector<Section>& sections) {
+    size_t bytes = sections.capacity() * sizeof(Section);
+    for (const auto& section : sections) bytes += section.notes.capacity() * sizeof(ChartNote);
+    return bytes;
+}
+
+void PsychConverter::logMemory(const MemoryUsage& mem, bool streamed) const {
+    auto mb = [](size_t bytes) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(2) << (bytes / (1024.0 * 1024.0)) << " MB";
+        return oss.str();
+    };
+    guiLogger.log("Memory:\n");
+    guiLogger.log("  Parse:         " + mb(mem.parsePeak()) + " (input " + mb(mem.inputBuffers) +
+                  ", decoded " + mb(mem.decodedNotes) + ")\n");
+    guiLogger.log("  Build:         " + mb(mem.buildPeak()) + " (notes " + mb(mem.chartNotes) +
+                  ", sections " + mb(mem.sections) + ")\n");
+    guiLogger.log("  Output:        " + mb(mem.outputPeak()) + (streamed ? " (streamed)" : "") + "\n");
+    guiLogger.log("  Peak:          " + mb(mem.peak()) +
+                  (m_config.maxMemoryBytes > 0 ? " of " + mb(m_config.maxMemoryBytes) + " budget" : "") +
+                  "\n\n");
+}
+
+// ─── logMidiInfo ─────────────────────────────────────────────────────────────
+
+void PsychConverter::logMidiInfo(const std::vector<MIDIParser>& parsers) const {
+    if (parsers.empty()) return;
+    uint16_t ppq      = parsers[0].ppq;
+    double   baseBPM  = parsers[0].bpm;
+    double   finalBPM = baseBPM * m_config.bpmMultiplier;
+
+    const MIDIParser* tempoSrc = &parsers[0];
+    for (const auto& p : parsers)
+        if (!p.tempoChanges.empty()) { tempoSrc = &p; break; }
+    auto& tempoChanges = tempoSrc->tempoChanges;
 
     guiLogger.log("MIDI Info:\n");
     guiLogger.log("  PPQ:           " + std::to_string(ppq) + "\n");
@@ -430,6 +1308,139 @@ bool PsychConverter::convert(const std::string& p1File,
             guiLogger.log("  ... and " + std::to_string(tempoChanges.size() - 6) + " more\n");
         guiLogger.log("\n");
     }
+}
+
+// ─── convert ─────────────────────────────────────────────────────────────────
+
+std::vector<PsychConverter::Input> PsychConverter::playerInputs(const std::string& p1File,
+                                                                const std::string& p2File) const {
+    return {{p1File, 1, 0, m_config.p1Filter}, {p2File, 2, 0, m_config.p2Filter}};
+}
+
+bool PsychConverter::convert(const std::string& p1File,
+                              const std::string& p2File,
+                              const std::string& outFile) {
+    return convert(playerInputs(p1File, p2File), outFile);
+}
+
+bool PsychConverter::convert(const std::vector<Input>& inputs, const std::string& outFile) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    // ── Metadata fast path ────────────────────────────────────────────────
+    const uint64_t hash = sourceHash(inputs);
+    if (m_config.reuseOutput && patchMetadata(outFile, hash)) return true;
+    if (stopRequested()) { logStopped(); return false; }
+
+    // ── Memory budget ─────────────────────────────────────────────────────
+    // Projections err high: a decoded note (12 bytes) takes at least 6 bytes
+    // of events, so parsing a file peaks at 3x its size (buffer + notes), and
+    // a chart note is held in the working list and again, with growth slack,
+    // in its section.
+    const size_t budget = m_config.maxMemoryBytes;
+    auto mb = [](size_t bytes) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1) << (bytes / (1024.0 * 1024.0));
+        return oss.str();
+    };
+    auto overBudget = [&](const std::string& stage, size_t needed) {
+        guiLogger.logColored("\n[X] " + stage + " needs ~" + mb(needed) + " MB, over the " +
+                             mb(budget) + " MB memory budget\n", RED);
+        return false;
+    };
+
+    bool parallel = true;
+    if (budget > 0) {
+        size_t total = 0, largest = 0;
+        const std::string* largestFile = nullptr;
+        for (const Input& in : inputs) {
+            std::error_code ec;
+            size_t size = static_cast<size_t>(std::filesystem::file_size(in.file, ec));
+            if (ec) size = 0;
+            total += size;
+            if (!largestFile || size > largest) { largest = size; largestFile = &in.file; }
+        }
+        if (3 * largest > budget) return overBudget("Reading " + *largestFile, 3 * largest);
+        parallel = total * 3 <= budget;
+    }
+
+    // ── MIDI parsing ──────────────────────────────────────────────────────
+    std::vector<MIDIParser> parsers;
+    if (!parseInputs(inputs, parsers, m_config.minVelocity, true, parallel))
+        return false;
+
+    MemoryUsage mem;
+    for (const auto& p : parsers) {
+        mem.inputBuffers = parallel ? mem.inputBuffers + p.bufferBytes
+                                    : std::max(mem.inputBuffers, p.bufferBytes);
+        mem.decodedNotes += p.resultBytes();
+    }
+
+    if (budget > 0) {
+        size_t decoded = 0;
+        for (const auto& p : parsers)
+            for (const auto& track : p.tracks) decoded += track.size();
+        size_t projected = mem.decodedNotes + 3 * decoded * sizeof(ChartNote);
+        if (projected > budget)
+            return overBudget("Building " + std::to_string(decoded) + " notes", projected);
+    }
+
+    // ── Note processing ───────────────────────────────────────────────────
+    ProgressBar convertBar("Converting", 40);
+    convertBar.setHandle(m_progressHandle);
+
+    BuiltChart chart = buildChart(inputs, parsers, &convertBar);
+    if (stopRequested()) { logStopped(); return false; }
+
+    convertBar.finish("Sections built!");
+
+    // Only the tempo maps are needed from here on.
+    for (auto& p : parsers) std::vector<std::vector<MIDINote>>().swap(p.tracks);
+
+    mem.chartNotes = chart.noteBytes;
+    mem.sections   = sectionBytes(chart.sections);
+
+    // ── File output ───────────────────────────────────────────────────────
+    // Files are written through two buffers each; only sharding holds the
+    // serialised JSON (cuts need section sizes), and over budget measures
+    // and re-serialises instead.
+    const size_t jsonEstimate = chart.totalNotes * 32 + chart.sections.size() * 110;
+    const bool   stream       = budget > 0 && sharding() && mem.sections + jsonEstimate > budget;
+
+    std::vector<std::string> outputFiles;
+    size_t           totalFileSize = 0;
+    CompressionStats packed;
+
+    if (stream) guiLogger.logColored("Memory budget: streaming JSON to disk\n", YELLOW);
+    if (!writeChart(chart, outFile, outputFiles, totalFileSize, stream, &mem.output, &packed)) {
+        if (stopRequested()) logStopped();
+        return false;
+    }
+    saveFingerprint(outFile, hash, chart.finalBPM, outputFiles);
+
+    // ── Stats ─────────────────────────────────────────────────────────────
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+    guiLogger.logColored("\n=== CONVERSION SUCCESSFUL ===\n\n", GREEN);
+    guiLogger.log("Chart Statistics:\n");
+    guiLogger.log("  Total Notes:   " + std::to_string(chart.totalNotes) + "\n");
+    guiLogger.log("  P1 Notes:      " + std::to_string(chart.p1Notes) + "\n");
+    guiLogger.log("  P2 Notes:      " + std::to_string(chart.totalNotes - chart.p1Notes) + "\n");
+    guiLogger.log("  Sections:      " + std::to_string(chart.sections.size()) + "\n\n");
+
+    if (chart.mergedNotes > 0)
+        guiLogger.log("Merged " + std::to_string(chart.mergedNotes) + " stacked notes\n\n");
+    if (chart.resolvedHolds > 0)
+        guiLogger.log(std::string(m_config.sustainOverlap == 1 ? "Trimmed " : "Tapped ") +
+                      std::to_string(chart.resolvedHolds) + " overlapping sustains\n\n");
+    if (chart.thinnedNotes > 0) logThinning(chart);
+
+    logMidiInfo(parsers);
+    logMemory(mem, stream);
 
     std::ostringstream oss;
     oss << std::fixed << std::setprecision(2);
@@ -437,7 +1448,9 @@ bool PsychConverter::convert(const std::string& p1File,
     if (outputFiles.size() > 1)
         oss << "  Files Created: " << outputFiles.size() << "\n";
     oss << "  Total Size:    " << (totalFileSize / 1024.0) << " KB\n";
+    oss << compressionLine(packed, totalFileSize);
     oss << "  Process Time:  " << elapsed.count() << " ms\n";
+    oss << "  SIMD Kernels:  " << CpuFeatures::name(CpuFeatures::active()) << "\n";
     if (outputFiles.size() == 1)
         oss << "  Location:      " << outputFiles[0] << "\n\n";
     else
@@ -446,3 +1459,788 @@ bool PsychConverter::convert(const std::string& p1File,
 
     return true;
 }
+
+// ─── convertDifficulties ─────────────────────────────────────────────────────
+
+bool PsychConverter::convertDifficulties(const std::string& p1File,
+                                         const std::string& p2File,
+                                         const std::vector<Difficulty>& difficulties) {
+    return convertDifficulties(playerInputs(p1File, p2File), difficulties);
+}
+
+bool PsychConverter::convertDifficulties(const std::vector<Input>& inputs,
+                                         const std::vector<Difficulty>& difficulties) {
+    if (difficulties.empty()) {
+        guiLogger.logColored("\n[X] No difficulties given!\n", RED);
+        return false;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    // One converter per difficulty: the base config with that chart's
+    // overrides.  Parse-level settings (the inputs' filters, sustain) always
+    // come from the base so every chart can share the parse.
+    std::vector<PsychConverter> charts(difficulties.size());
+    int loosestVelocity = 127;
+    for (size_t i = 0; i < difficulties.size(); ++i) {
+        Config cfg       = difficulties[i].config;
+        cfg.p1Filter     = m_config.p1Filter;
+        cfg.p2Filter     = m_config.p2Filter;
+        cfg.sustainNotes = m_config.sustainNotes;
+        charts[i].setConfig(cfg);
+        charts[i].setCancelToken(m_cancel);
+        loosestVelocity = std::min(loosestVelocity, charts[i].m_config.minVelocity);
+    }
+
+    std::vector<MIDIParser> parsers;
+    if (!parseInputs(inputs, parsers, loosestVelocity))
+        return false;
+
+    guiLogger.logColored("Building " + std::to_string(difficulties.size()) +
+                         " difficulties in parallel...\n", YELLOW);
+
+    struct Result {
+        BuiltChart               chart;
+        std::vector<std::string> files;
+        size_t                   bytes = 0;
+        CompressionStats         packed;
+        bool                     ok    = false;
+    };
+    std::vector<std::future<Result>> jobs;
+    for (size_t i = 0; i < difficulties.size(); ++i) {
+        jobs.push_back(std::async(std::launch::async, [&, i]() {
+            Result r;
+            r.chart = charts[i].buildChart(inputs, parsers, nullptr);
+            r.ok    = charts[i].writeChart(r.chart, difficulties[i].outFile, r.files, r.bytes,
+                                           false, nullptr, &r.packed);
+            return r;
+        }));
+    }
+
+    std::vector<Result> results;
+    for (auto& job : jobs) results.push_back(job.get());
+
+    if (stopRequested()) {
+        logStopped();
+        return false;
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+    bool allOk = std::all_of(results.begin(), results.end(), [](const Result& r) { return r.ok; });
+    if (allOk) guiLogger.logColored("\n=== CONVERSION SUCCESSFUL ===\n\n", GREEN);
+    else       guiLogger.logColored("\n[X] Some difficulties failed to write!\n\n", RED);
+
+    guiLogger.log("Difficulties:\n");
+    size_t           totalFileSize = 0;
+    CompressionStats packed;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::ostringstream ds;
+        ds << std::fixed << std::setprecision(2)
+           << "  " << std::left << std::setw(10) << difficulties[i].name << std::right
+           << std::setw(8) << r.chart.totalNotes << " notes, "
+           << std::setw(5) << r.chart.sections.size() << " sections -> "
+           << (r.ok ? charts[i].compressedName(difficulties[i].outFile) : std::string("FAILED"));
+        if (r.chart.mergedNotes > 0)  ds << " (" << r.chart.mergedNotes  << " merged)";
+        if (r.chart.thinnedNotes > 0) ds << " (" << r.chart.thinnedNotes << " thinned)";
+        ds << "\n";
+        guiLogger.log(ds.str());
+        totalFileSize     += r.bytes;
+        packed.rawBytes   += r.packed.rawBytes;
+        packed.compressNs += r.packed.compressNs;
+    }
+    guiLogger.log("\n");
+
+    charts[0].logMidiInfo(parsers);
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Output:\n";
+    oss << "  Total Size:    " << (totalFileSize / 1024.0) << " KB\n";
+    oss << compressionLine(packed, totalFileSize);
+    oss << "  Process Time:  " << elapsed.count() << " ms\n\n";
+    guiLogger.log(oss.str());
+
+    return allOk;
+}
+
+// ─── convertMedley ───────────────────────────────────────────────────────────
+
+bool PsychConverter::convertMedley(const std::vector<MedleySegment>& segments,
+                                   const std::string& outFile) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    if (segments.empty()) {
+        guiLogger.logColored("[X] No medley segments given!\n", RED);
+        return false;
+    }
+    if (m_config.useRange) {
+        guiLogger.logColored("[X] A medley can't be converted with --range.\n", RED);
+        return false;
+    }
+    if (m_config.splitOutput || sharding() || m_config.binaryOutput) {
+        guiLogger.logColored("[X] A medley is written as a single JSON file (no split, shards or binary).\n", RED);
+        return false;
+    }
+
+    // ── Segment jobs: parse + build, a bounded window ahead of the writer ──
+    // Each job already parses its inputs in parallel, so the segment being
+    // written and two ahead of it keep the writer fed; a wider window would
+    // only hold more built charts in memory.  A memory budget builds one
+    // segment at a time with a serial parse.
+    struct Built {
+        BuiltChart chart;
+        bool       ok = false;
+    };
+    const bool   lowMemory = m_config.maxMemoryBytes > 0;
+    const size_t window    = lowMemory ? 1 : 3;
+    auto build = [this, &segments, lowMemory](size_t i) {
+        Built b;
+        std::vector<MIDIParser> parsers;
+        if (!parseInputs(segments[i].inputs, parsers, m_config.minVelocity, false, !lowMemory))
+            return b;
+        b.chart = buildChart(segments[i].inputs, parsers, nullptr);
+        b.ok    = !stopRequested();
+        return b;
+    };
+
+    std::deque<std::future<Built>> jobs;
+    size_t launched = 0;
+    auto launch = [&]() {
+        while (launched < segments.size() && jobs.size() < window)
+            jobs.push_back(std::async(std::launch::async, build, launched++));
+    };
+
+    guiLogger.logColored("Streaming " + std::to_string(segments.size()) + " segments, up to " +
+                         std::to_string(std::min(window, segments.size())) +
+                         " in parallel...\n", YELLOW);
+    launch();
+
+    const std::string target = compressedName(outFile);
+    OutputWriter writer({target}, kOutputBuffer);
+    writer.setCompression(m_config.compression, m_config.compressionLevel);
+    if (!writer.open(0, 0)) {
+        guiLogger.logColored("\n[X] Failed to write file: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+    std::string& buf = writer.buffer(0);
+    buf += chartHead();
+
+    const SectionWriter write = sectionWriter();
+    const SectionFormat fmt   = sectionFormat();
+
+    // Sections go out one at a time; a tempo differing from the last
+    // section's sets changeBPM.
+    size_t sectionCount = 0;
+    double lastBPM      = 0.0;
+    bool   lastMustHit  = true;
+    auto emit = [&](Section& section, bool boundary) {
+        if (boundary && sectionCount > 0 && section.bpm != lastBPM) section.changeBPM = true;
+        if (sectionCount++ > 0) buf += ',';
+        write(buf, section, fmt);
+        lastBPM     = section.bpm;
+        lastMustHit = section.mustHitSection;
+        return writer.flush(0);
+    };
+
+    struct SegmentStats {
+        size_t notes = 0, p1Notes = 0, firstSection = 0, sections = 0;
+        double startMs = 0.0, bpm = 0.0;
+    };
+    std::vector<SegmentStats> stats;
+    double songBPM = 120.0;
+    double timeMs  = 0.0;   // where the next segment (or its gap) starts
+    bool   ok      = true;
+
+    for (size_t i = 0; i < segments.size() && ok; ++i) {
+        Built b = jobs.front().get();
+        jobs.pop_front();
+        launch();
+        if (!b.ok || stopRequested()) { ok = false; break; }
+
+        std::vector<Section>& sections = b.chart.sections;
+        // Opening tempo: a changeBPM section's bpm is the one it ends on.
+        const double openBPM = sections.empty() || sections[0].changeBPM ? b.chart.finalBPM
+                                                                         : sections[0].bpm;
+        if (i == 0) songBPM = b.chart.finalBPM;
+
+        // ── Gap: empty sections at the opening tempo, or one section
+        //    exactly as long as a millisecond gap ──
+        const MedleySegment& seg = segments[i];
+        if (i > 0 && seg.gap > 0.0) {
+            auto gapSection = [&](double bpm) {
+                Section gap;
+                gap.mustHitSection = lastMustHit;
+                gap.bpm            = bpm;
+                return emit(gap, true);
+            };
+            if (seg.gapInBars) {
+                for (long n = std::lround(seg.gap); n > 0 && ok; --n) {
+                    ok      = gapSection(openBPM);
+                    timeMs += (60000.0 / openBPM) * 4;
+                }
+            } else {
+                ok      = gapSection((60000.0 * 4) / seg.gap);
+                timeMs += seg.gap;
+            }
+        }
+
+        SegmentStats st;
+        st.notes        = b.chart.totalNotes;
+        st.p1Notes      = b.chart.p1Notes;
+        st.firstSection = sectionCount;
+        st.sections     = sections.size();
+        st.startMs      = timeMs;
+        st.bpm          = openBPM;
+        stats.push_back(st);
+
+        for (size_t s = 0; s < sections.size() && ok; ++s) {
+            if ((s & 255) == 255 && stopRequested()) ok = false;
+            for (auto& n : sections[s].notes) n.time += timeMs;
+            ok = ok && emit(sections[s], s == 0);
+        }
+        timeMs += b.chart.sectionTimes.back();
+    }
+    // Jobs still running are waited for when `jobs` goes out of scope.
+
+    if (stopRequested()) {
+        jobs.clear();
+        logStopped();
+        return false;
+    }
+    buf += chartTail(songBPM);
+    if (!ok || !writer.close(0) || !writer.commit()) {
+        jobs.clear();
+        if (!writer.errorMessage.empty())
+            guiLogger.logColored("\n[X] Failed to write file: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+
+    // ── Stats ─────────────────────────────────────────────────────────────
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+
+    size_t totalNotes = 0, p1Notes = 0;
+    guiLogger.logColored("\n=== CONVERSION SUCCESSFUL ===\n\n", GREEN);
+    guiLogger.log("Segments:\n");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const SegmentStats& st = stats[i];
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2)
+           << "  " << std::setw(3) << (i + 1) << "  @ " << std::setw(8) << (st.startMs / 1000.0)
+           << "s  " << std::setw(7) << st.bpm << " BPM " << std::setw(8) << st.notes << " notes, "
+           << std::setw(5) << st.sections << " sections from " << st.firstSection
+           << "  " << segments[i].inputs[0].file << "\n";
+        guiLogger.log(ss.str());
+        totalNotes += st.notes;
+        p1Notes    += st.p1Notes;
+    }
+    guiLogger.log("\n");
+
+    guiLogger.log("Chart Statistics:\n");
+    guiLogger.log("  Total Notes:   " + std::to_string(totalNotes) + "\n");
+    guiLogger.log("  P1 Notes:      " + std::to_string(p1Notes) + "\n");
+    guiLogger.log("  P2 Notes:      " + std::to_string(totalNotes - p1Notes) + "\n");
+    guiLogger.log("  Sections:      " + std::to_string(sectionCount) + "\n\n");
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Output:\n";
+    oss << "  Length:        " << (timeMs / 1000.0) << " s\n";
+    oss << "  Total Size:    " << (writer.size(0) / 1024.0) << " KB\n";
+    oss << compressionLine({writer.rawSize(0), writer.compressNs()}, writer.size(0));
+    oss << "  Process Time:  " << elapsed.count() << " ms\n";
+    oss << "  Location:      " << target << "\n\n";
+    guiLogger.log(oss.str());
+    return true;
+}
+
+// ─── watch ───────────────────────────────────────────────────────────────────
+
+bool PsychConverter::watch(const std::string& p1File,
+                           const std::string& p2File,
+                           const std::string& outFile) {
+    return watch(playerInputs(p1File, p2File), outFile);
+}
+
+bool PsychConverter::watch(const std::vector<Input>& inputs, const std::string& outFile) {
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    // Watch re-serialises only changed sections of the JSON text.
+    if (m_config.binaryOutput) {
+        guiLogger.logColored("[X] Watch mode writes JSON; drop --binary (or --transcode afterwards).\n", RED);
+        return false;
+    }
+
+    std::vector<std::string> files;
+    for (const Input& in : inputs) files.push_back(in.file);
+    FileWatcher watcher(files);
+    if (!watcher.ok()) {
+        guiLogger.logColored("\n[X] Could not watch the input files!\n", RED);
+        return false;
+    }
+
+    // Previous run: decoded notes, built sections and their JSON, and the
+    // files as last written.
+    struct Decoded {
+        std::vector<std::vector<MIDINote>> tracks;
+        std::vector<TempoChange>           tempoChanges;
+        uint16_t                           ppq = 0;
+
+        bool operator==(const MIDIParser& p) const {
+            return ppq == p.ppq && tracks == p.tracks && tempoChanges == p.tempoChanges;
+        }
+    };
+    std::vector<Decoded>     lastInputs;
+    std::vector<Section>     lastSections;
+    std::vector<std::string> lastParts;
+    std::vector<OutputFile>  lastFiles;
+    bool                     first = true;
+
+    auto run = [&]() {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        std::vector<MIDIParser> parsers;
+        if (!parseInputs(inputs, parsers, m_config.minVelocity, first))
+            return;   // likely caught mid-save; the next write triggers again
+
+        if (!first && std::equal(lastInputs.begin(), lastInputs.end(), parsers.begin())) {
+            guiLogger.log("No note changes.\n");
+            return;
+        }
+
+        BuiltChart chart = buildChart(inputs, parsers, nullptr);
+        if (stopRequested()) return;
+
+        // Re-serialise only sections that differ from the last run.  The
+        // cached text is copied, not moved: a run that stops or fails to
+        // write leaves the caches as they were for the next one.
+        const SectionWriter write = sectionWriter();
+        const SectionFormat fmt   = sectionFormat();
+        std::vector<std::string> parts(chart.sections.size());
+        size_t changedSections = 0;
+        for (size_t i = 0; i < chart.sections.size(); ++i) {
+            if (i < lastSections.size() && chart.sections[i] == lastSections[i]) {
+                parts[i] = lastParts[i];
+            } else {
+                write(parts[i], chart.sections[i], fmt);
+                ++changedSections;
+            }
+        }
+
+        if (stopRequested()) return;
+
+        std::vector<OutputFile> files = renderChart(chart, outFile, parts);
+        auto changedFiles = [&](size_t from, size_t to) {
+            std::vector<OutputFile> changed;
+            for (size_t i = from; i < to; ++i) {
+                if (i >= lastFiles.size() || lastFiles[i].name != files[i].name ||
+                    lastFiles[i].json != files[i].json)
+                    changed.push_back(files[i]);
+            }
+            return changed;
+        };
+        // Compressed shards go first; the manifest then lists their sizes
+        // on disk, unchanged shards' included.
+        const size_t shardFiles = files.size() - (manifestLast() ? 1 : 0);
+        std::vector<OutputFile> changed = changedFiles(0, shardFiles);
+        if (!writeFiles(changed))
+            return;   // retried on the next change
+        size_t written = changed.size();
+        if (shardFiles < files.size()) {
+            std::vector<size_t>   sizes;
+            std::vector<uint64_t> stored;
+            for (const auto& part : parts) sizes.push_back(part.size());
+            for (size_t i = 0; i < shardFiles; ++i) {
+                std::error_code ec;
+                stored.push_back(std::filesystem::file_size(files[i].name, ec));
+                if (ec) stored.back() = 0;
+            }
+            files.back().json = planOutput(chart, outFile, sizes, &stored).back().head;
+            changed = changedFiles(shardFiles, files.size());
+            if (!writeFiles(changed))
+                return;
+            written += changed.size();
+        }
+        // Split files or shards left over from a longer chart.
+        for (const auto& old : lastFiles) {
+            bool kept = std::any_of(files.begin(), files.end(),
+                [&](const OutputFile& f) { return f.name == old.name; });
+            if (!kept) std::remove(old.name.c_str());
+        }
+
+        lastInputs.clear();
+        for (auto& p : parsers)
+            lastInputs.push_back({std::move(p.tracks), std::move(p.tempoChanges), p.ppq});
+        lastSections   = std::move(chart.sections);
+        lastParts      = std::move(parts);
+        lastFiles      = std::move(files);
+        first          = false;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - startTime);
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(2)
+            << "Updated " << changedSections << "/" << lastSections.size() << " sections, "
+            << written << " file(s) written in " << (elapsed.count() / 1000.0) << " ms\n";
+        guiLogger.logColored(oss.str(), GREEN);
+    };
+
+    run();
+    std::string watched;
+    for (size_t i = 0; i < files.size(); ++i)
+        watched += (i == 0 ? "" : i + 1 == files.size() ? " and " : ", ") + files[i];
+    guiLogger.logColored("Watching " + watched + " (Ctrl+C to stop)...\n", YELLOW);
+
+    while (!stopRequested() && watcher.waitForChange(50, m_cancel))
+        run();
+
+    if (stopRequested()) logStopped();
+    else                 guiLogger.logColored("\n[X] File watch failed!\n", RED);
+    return false;
+}
+
+// ─── transcode ───────────────────────────────────────────────────────────────
+
+bool PsychConverter::transcode(const std::string& inFile, const std::string& outFile) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    Psych Engine Chart Transcoder v2.4\n",             CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    const bool  toJSON = BinaryChart::sniff(inFile);
+    if (!toJSON && m_config.compression != StreamCompressor::kNone) {
+        guiLogger.logColored("[X] --compress applies to JSON output; binary charts are written as they are.\n", RED);
+        return false;
+    }
+    ChartReader reader;
+    ChartData   data;
+    if (!reader.read(inFile, data)) {
+        guiLogger.logColored("[X] Cannot read chart: " + reader.errorMessage + "\n", RED);
+        return false;
+    }
+    auto readTime = std::chrono::high_resolution_clock::now();
+    if (stopRequested()) { logStopped(); return false; }
+
+    // The chart's own song fields; output options stay as configured.
+    m_config.songName     = data.songName;
+    m_config.p1Char       = data.player1;
+    m_config.p2Char       = data.player2;
+    m_config.gfChar       = data.gfVersion;
+    m_config.stage        = data.stage;
+    m_config.speed        = data.speed;
+    m_config.mania        = data.mania;
+    m_config.binaryOutput = !toJSON;
+    clampConfig();
+
+    BuiltChart chart;
+    chart.finalBPM     = data.bpm;
+    chart.totalNotes   = data.noteCount;
+    chart.sectionTimes = data.sectionTimes();
+    chart.sections     = std::move(data.sections);
+    const int k = m_config.mania + 1;
+    for (const auto& s : chart.sections)
+        for (const auto& n : s.notes)
+            chart.p1Notes += n.lane >= 0 && n.lane < 2 * k && (n.lane < k) == s.mustHitSection;
+
+    std::vector<std::string> outputFiles;
+    size_t           totalFileSize = 0;
+    CompressionStats packed;
+    if (!writeChart(chart, outFile, outputFiles, totalFileSize, false, nullptr, &packed)) {
+        if (stopRequested()) logStopped();
+        return false;
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto ms = [](auto d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+    std::error_code ec;
+    const auto inSize = std::filesystem::file_size(inFile, ec);
+
+    guiLogger.logColored("\n=== TRANSCODE SUCCESSFUL ===\n\n", GREEN);
+    guiLogger.log("Chart Statistics:\n");
+    guiLogger.log("  Song:          " + m_config.songName + "\n");
+    guiLogger.log("  Total Notes:   " + std::to_string(chart.totalNotes) + "\n");
+    guiLogger.log("  P1 Notes:      " + std::to_string(chart.p1Notes) + "\n");
+    guiLogger.log("  P2 Notes:      " + std::to_string(chart.totalNotes - chart.p1Notes) + "\n");
+    guiLogger.log("  Sections:      " + std::to_string(chart.sections.size()) + "\n\n");
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Output:\n";
+    oss << "  Format:        " << (toJSON ? "binary -> JSON" : "JSON -> binary") << "\n";
+    if (!ec) oss << "  Input Size:    " << (inSize / 1024.0) << " KB\n";
+    oss << "  Total Size:    " << (totalFileSize / 1024.0) << " KB\n";
+    oss << compressionLine(packed, totalFileSize);
+    oss << "  Read Time:     " << ms(readTime - startTime) << " ms\n";
+    oss << "  Process Time:  " << ms(endTime - startTime) << " ms\n";
+    if (outputFiles.size() == 1)
+        oss << "  Location:      " << outputFiles[0] << "\n\n";
+    else
+        oss << "  Base Name:     " << outFile << "\n\n";
+    guiLogger.log(oss.str());
+    return true;
+}
+
+// ─── exportMidi ──────────────────────────────────────────────────────────────
+
+bool PsychConverter::exportMidi(const std::string& chartFile,
+                                const std::string& p1File,
+                                const std::string& p2File,
+                                uint16_t ppq) const {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    Psych Engine -> MIDI Export v2.4\n",               CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    ChartReader reader;
+    ChartData   chart;
+    if (!reader.read(chartFile, chart)) {
+        guiLogger.logColored("[X] Cannot read chart: " + reader.errorMessage + "\n", RED);
+        return false;
+    }
+    auto readTime = std::chrono::high_resolution_clock::now();
+    if (stopRequested()) { logStopped(); return false; }
+
+    MIDIWriter writer;
+    writer.ppq = ppq;
+    if (!writer.write(chart, p1File, p2File)) {
+        guiLogger.logColored("[X] Failed to write MIDI: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto ms = [](auto d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+
+    guiLogger.logColored("=== EXPORT SUCCESSFUL ===\n\n", GREEN);
+    guiLogger.log("Chart Statistics:\n");
+    guiLogger.log("  Song:          " + chart.songName + "\n");
+    guiLogger.log("  Total Notes:   " + std::to_string(chart.noteCount) + "\n");
+    guiLogger.log("  P1 Notes:      " + std::to_string(writer.p1Notes) + "\n");
+    guiLogger.log("  P2 Notes:      " + std::to_string(writer.p2Notes) + "\n");
+    guiLogger.log("  Sections:      " + std::to_string(chart.sections.size()) + "\n\n");
+    if (writer.droppedNotes > 0)
+        guiLogger.logColored("Skipped " + std::to_string(writer.droppedNotes) +
+                             " notes outside both players' lanes or duplicated\n\n", YELLOW);
+
+    std::ostringstream oss;
+    oss << "Output:\n";
+    oss << "  PPQ:           " << writer.ppq << "\n";
+    oss << "  Read Time:     " << ms(readTime - startTime) << " ms\n";
+    oss << "  Process Time:  " << ms(endTime - startTime) << " ms\n";
+    oss << "  Location:      " << p1File << ", " << p2File << "\n\n";
+    guiLogger.log(oss.str());
+    return true;
+}
+
+// ─── patchRange ──────────────────────────────────────────────────────────────
+
+bool PsychConverter::patchRange(const std::string& p1File,
+                                const std::string& p2File,
+                                const std::string& chartFile) {
+    return patchRange(playerInputs(p1File, p2File), chartFile);
+}
+
+bool PsychConverter::patchRange(const std::vector<Input>& inputs, const std::string& chartFile) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    guiLogger.logColored("\n================================================\n", CYAN);
+    guiLogger.logColored("    MIDI -> Psych Engine Converter v2.4\n",            CYAN);
+    guiLogger.logColored("================================================\n\n",  CYAN);
+
+    if (!m_config.useRange) {
+        guiLogger.logColored("[X] Patching needs a --range to re-convert.\n", RED);
+        return false;
+    }
+    if (m_config.splitOutput || sharding() || m_config.binaryOutput ||
+        m_config.compression != StreamCompressor::kNone) {
+        guiLogger.logColored("[X] Split, sharded, binary and compressed charts can't be patched.\n", RED);
+        return false;
+    }
+
+    // ── Existing chart: section spans, and its song fields for the key count ──
+    ChartReader               reader;
+    ChartReader::SectionSpans spans;
+    ChartData                 meta;
+    std::string               text, fields;
+    bool read = reader.loadFile(chartFile, text) && reader.locateSections(text, spans, chartFile);
+    if (read) {
+        fields = text.substr(0, spans.arrayBegin) + "[]" + text.substr(spans.arrayEnd);
+        read   = reader.parse(fields.data(), fields.size(), meta, chartFile);
+    }
+    if (!read) {
+        guiLogger.logColored("[X] Cannot read chart: " + reader.errorMessage + "\n", RED);
+        return false;
+    }
+    if (meta.mania != m_config.mania) {
+        guiLogger.log("Using the chart's key count: " + std::to_string(meta.keyCount()) + "\n");
+        m_config.mania = meta.mania;
+        clampConfig();
+    }
+
+    // ── Re-convert the range ──────────────────────────────────────────────
+    uint32_t  startTick, endTick;
+    RangeSpan span;
+    if (!resolveRange(inputs, startTick, endTick, false, &span)) return false;
+
+    std::vector<MIDIParser> parsers;
+    if (!parseInputs(inputs, parsers, m_config.minVelocity)) return false;
+
+    ProgressBar convertBar("Converting", 40);
+    convertBar.setHandle(m_progressHandle);
+    BuiltChart chart = buildChart(inputs, parsers, &convertBar);
+    if (stopRequested()) { logStopped(); return false; }
+    convertBar.finish("Sections built!");
+
+    // Sections [first, end) are rebuilt; a range past the chart's end
+    // appends to it.
+    const size_t oldCount = spans.sections.size();
+    const size_t first    = std::min(span.firstSection, oldCount);
+    const size_t end      = std::max(first, std::min(span.endSection,
+                                                     std::max(oldCount, chart.sections.size())));
+    if (first == end) {
+        guiLogger.logColored("Nothing to patch: the range lies past the chart's end.\n", YELLOW);
+        return true;
+    }
+
+    auto oldSection = [&](size_t i, Section& out) {
+        const auto& [b, e] = spans.sections[i];
+        std::string wrapped = R"({"notes":[)" + text.substr(b, e - b) + "]}";
+        ChartData   d;
+        if (!reader.parse(wrapped.data(), wrapped.size(), d,
+                          chartFile + " section " + std::to_string(i)) || d.sections.size() != 1) {
+            guiLogger.logColored("[X] Cannot read chart: " + reader.errorMessage + "\n", RED);
+            return false;
+        }
+        out = std::move(d.sections[0]);
+        return true;
+    };
+
+    // ── Merge: old notes outside the range, new ones inside ───────────────
+    // Notes are re-sided by each section's mustHitSection, then laid out as
+    // buildChart does, carrying mustHitSection on from the section before.
+    const int     k        = m_config.mania + 1;
+    const int64_t offsetNs = std::llround(m_config.noteOffset * 1e6);
+    bool mustHit = true;
+    if (first > 0) {
+        Section before;
+        if (!oldSection(first - 1, before)) return false;
+        mustHit = before.mustHitSection;
+    }
+
+    struct Tagged {
+        ChartNote note;
+        int       key;   // buildChart's order: P1 lane, 100 + P2 lane, other lanes last
+    };
+    auto tag = [k](const Section& s, const ChartNote& n) -> Tagged {
+        if (n.lane < 0 || n.lane >= 2 * k) return {n, 1000 + n.lane};
+        bool p1 = s.mustHitSection == (n.lane < k);
+        return {n, (p1 ? 0 : 100) + n.lane % k};
+    };
+
+    const SectionWriter write = sectionWriter();
+    const SectionFormat fmt   = sectionFormat();
+    std::vector<std::string> parts(end - first);
+    size_t keptNotes = 0, newNotes = 0;
+    std::vector<Tagged> notes;
+    for (size_t i = first; i < end; ++i) {
+        if (stopRequested()) { logStopped(); return false; }
+        Section old;
+        if (i < oldCount && !oldSection(i, old)) return false;
+        const Section* built = i < chart.sections.size() ? &chart.sections[i] : nullptr;
+
+        notes.clear();
+        for (const auto& n : old.notes) {
+            int64_t ns = std::llround(n.time * 1e6) - offsetNs;
+            if (ns >= span.startNs && ns < span.endNs) continue;
+            notes.push_back(tag(old, n));
+            ++keptNotes;
+        }
+        if (built) {
+            for (const auto& n : built->notes) notes.push_back(tag(*built, n));
+            newNotes += built->notes.size();
+        }
+        std::stable_sort(notes.begin(), notes.end(), [](const Tagged& a, const Tagged& b) {
+            return a.note.time < b.note.time || (a.note.time == b.note.time && a.key < b.key);
+        });
+
+        int p1Count = 0, p2Count = 0;
+        for (const auto& t : notes)
+            if (t.key < 1000) (t.key < 100 ? p1Count : p2Count)++;
+        if (p1Count + p2Count > 0) mustHit = p1Count >= p2Count;
+
+        Section section;
+        section.mustHitSection = mustHit;
+        section.bpm            = built ? built->bpm : old.bpm;
+        section.changeBPM      = built ? built->changeBPM : old.changeBPM;
+        section.notes.reserve(notes.size());
+        for (const auto& t : notes) {
+            int lane = t.note.lane;
+            if (t.key < 1000) {
+                bool p1 = t.key < 100;
+                lane    = t.key % 100 + (p1 == mustHit ? 0 : k);
+            }
+            section.notes.emplace_back(t.note.time, lane, t.note.duration);
+        }
+        write(parts[i - first], section, fmt);
+    }
+
+    // ── Splice ────────────────────────────────────────────────────────────
+    const size_t oldEnd   = oldCount ? spans.sections.back().second : spans.arrayBegin + 1;
+    const size_t cutBegin = first < oldCount ? spans.sections[first].first : oldEnd;
+    const size_t cutEnd   = end <= oldCount ? spans.sections[end - 1].second : oldEnd;
+    const bool   comma    = first >= oldCount && oldCount > 0;   // appending after the last
+
+    size_t newSize = text.size() - (cutEnd - cutBegin) + comma + (parts.size() - 1);
+    for (const auto& p : parts) newSize += p.size();
+
+    OutputWriter writer({chartFile});
+    bool ok = writer.open(0, newSize) && writer.write(0, text.data(), cutBegin) &&
+              (!comma || writer.write(0, ",", 1));
+    for (size_t p = 0; ok && p < parts.size(); ++p)
+        ok = (p == 0 || writer.write(0, ",", 1)) && writer.write(0, parts[p].data(), parts[p].size());
+    ok = ok && writer.write(0, text.data() + cutEnd, text.size() - cutEnd);
+    if (stopRequested()) { logStopped(); return false; }
+    if (!ok || !writer.commit()) {
+        guiLogger.logColored("\n[X] Failed to write file: " + writer.errorMessage + "\n", RED);
+        return false;
+    }
+
+    // ── Stats ─────────────────────────────────────────────────────────────
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+
+    guiLogger.logColored("\n=== PATCH SUCCESSFUL ===\n\n", GREEN);
+    guiLogger.log("Chart Statistics:\n");
+    guiLogger.log("  Sections:      " + std::to_string(first + 1) + "-" + std::to_string(end) +
+                  " rebuilt (" + std::to_string(std::max(end, oldCount)) + " in chart)\n");
+    guiLogger.log("  New Notes:     " + std::to_string(newNotes) + "\n");
+    guiLogger.log("  Kept Notes:    " + std::to_string(keptNotes) + " (outside the range)\n\n");
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Output:\n";
+    oss << "  Copied:        " << ((text.size() - (cutEnd - cutBegin)) / 1024.0) << " KB unchanged\n";
+    oss << "  Total Size:    " << (newSize / 1024.0) << " KB\n";
+    oss << "  Process Time:  " << elapsed.count() << " ms\n";
+    oss << "  Location:      " << chartFile << "\n\n";
+    guiLogger.log(oss.str());
+    return true;
+}
@@ -0,0 +1,102 @@
+#include "midi_parser.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// ─── Sidecar format ───────────────────────────────────────────────────────────
+//
+//   "M2PSEEK1"  u64 fileSize  i64 mtime  u32 trackCount
+//   per track:  u8 seekable  u32 pointCount  { u32 tick  u32 pos  u8 runningStatus }*
+//
+// Little-endian as written by the host; a foreign or stale file just fails
+// to load and the index is rebuilt.
+
+namespace {
+
+constexpr char kMagic[8] = {'M', '2', 'P', 'S', 'E', 'E', 'K', '1'};
+
+std::string sidecarPath(const std::string& midiFile) { return midiFile + ".seek"; }
+
+bool fileStamp(const std::string& midiFile, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(std::filesystem::file_size(midiFile, ec));
+    if (ec) return false;
+    auto t = std::filesystem::last_write_time(midiFile, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(t.time_since_epoch().count());
+    return true;
+}
+
+template <typename T> void put(std::ofstream& out, T v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+template <typename T> bool get(std::ifstream& in, T& v) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(v)));
+}
+
+} // namespace
+
+// ─── load ─────────────────────────────────────────────────────────────────────
+
+bool SeekIndex::load(const std::string& midiFile) {
+    *this = SeekIndex{};
+
+    uint64_t size;
+    int64_t  mtime;
+    if (!fileStamp(midiFile, size, mtime)) return false;
+
+    std::ifstream in(sidecarPath(midiFile), std::ios::binary);
+    char magic[8];
+    if (!in || !in.read(magic, 8) || std::memcmp(magic, kMagic, 8) != 0) return false;
+
+    SeekIndex idx;
+    uint32_t  trackCount;
+    if (!get(in, idx.fileSize) || !get(in, idx.mtime) || !get(in, trackCount)) return false;
+    if (idx.fileSize != size || idx.mtime != mtime || trackCount > 0xffff) return false;
+
+    idx.tracks.resize(trackCount);
+    for (auto& track : idx.tracks) {
+        uint8_t  seekable;
+        uint32_t count;
+        if (!get(in, seekable) || !get(in, count)) return false;
+        // Points are at least one indexed event apart.
+        if (count > size) return false;
+        track.seekable = seekable != 0;
+        track.points.resize(count);
+        for (auto& sp : track.points) {
+            if (!get(in, sp.tick) || !get(in, sp.pos) || !get(in, sp.runningStatus)) return false;
+            if (sp.pos >= size) return false;
+        }
+    }
+
+    *this = std::move(idx);
+    return true;
+}
+
+// ─── save ─────────────────────────────────────────────────────────────────────
+
+bool SeekIndex::save(const std::string& midiFile) const {
+    uint64_t size;
+    int64_t  stamp;
+    if (tracks.empty() || !fileStamp(midiFile, size, stamp) || size != fileSize) return false;
+
+    std::ofstream out(sidecarPath(midiFile), std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    out.write(kMagic, 8);
+    put(out, fileSize);
+    put(out, stamp);
+    put(out, static_cast<uint32_t>(tracks.size()));
+    for (const auto& track : tracks) {
+        put(out, static_cast<uint8_t>(track.seekable));
+        put(out, static_cast<uint32_t>(track.points.size()));
+        for (const auto& sp : track.points) {
+            put(out, sp.tick);
+            put(out, sp.pos);
+            put(out, sp.runningStatus);
+        }
+    }
+    return static_cast<bool>(out);
+}
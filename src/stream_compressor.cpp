@@ -0,0 +1,287 @@
+#include "stream_compressor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#ifdef M2P_HAVE_ZLIB
+  #include <zlib.h>
+#endif
+#ifdef M2P_HAVE_ZSTD
+  #include <zstd.h>
+#endif
+
+namespace {
+
+constexpr size_t kChunk = size_t(1) << 16;   // output grown this much at a time
+
+} // namespace
+
+// ─── Codecs ───────────────────────────────────────────────────────────────────
+
+bool StreamCompressor::available(Codec codec) {
+    switch (codec) {
+        case kNone: return true;
+#ifdef M2P_HAVE_ZLIB
+        case kGzip: return true;
+#endif
+#ifdef M2P_HAVE_ZSTD
+        case kZstd: return true;
+#endif
+        default:    return false;
+    }
+}
+
+const char* StreamCompressor::name(Codec codec) {
+    switch (codec) {
+        case kGzip: return "gzip";
+        case kZstd: return "zstd";
+        default:    return "none";
+    }
+}
+
+const char* StreamCompressor::extension(Codec codec) {
+    switch (codec) {
+        case kGzip: return ".gz";
+        case kZstd: return ".zst";
+        default:    return "";
+    }
+}
+
+int StreamCompressor::defaultLevel(Codec codec) {
+    switch (codec) {
+        case kGzip: return 6;
+        case kZstd: return 3;
+        default:    return 0;
+    }
+}
+
+bool StreamCompressor::parse(const std::string& spec, Codec& codec, int& level, std::string& error) {
+    const size_t      colon = spec.find(':');
+    const std::string kind  = spec.substr(0, colon);
+    if      (kind == "none")                  codec = kNone;
+    else if (kind == "gzip" || kind == "gz")  codec = kGzip;
+    else if (kind == "zstd" || kind == "zst") codec = kZstd;
+    else {
+        error = "unknown codec '" + kind + "' (none, gzip or zstd)";
+        return false;
+    }
+    if (!available(codec)) {
+        error = std::string(name(codec)) + " support was not built in";
+        return false;
+    }
+
+    level = 0;
+    if (colon != std::string::npos) {
+        const int lo = 1, hi = codec == kZstd ? 22 : 9;
+        try {
+            level = std::stoi(spec.substr(colon + 1));
+        } catch (...) {
+            level = -1;
+        }
+        if (codec == kNone || level < lo || level > hi) {
+            error = "level must be " + std::to_string(lo) + "-" + std::to_string(hi) +
+                    " for " + name(codec);
+            return false;
+        }
+    }
+    return true;
+}
+
+StreamCompressor::Codec StreamCompressor::sniff(const char* data, size_t size) {
+    const auto* b = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && b[0] == 0x1f && b[1] == 0x8b) return kGzip;
+    if (size >= 4 && b[0] == 0x28 && b[1] == 0xb5 && b[2] == 0x2f && b[3] == 0xfd) return kZstd;
+    return kNone;
+}
+
+// ─── Decompression ────────────────────────────────────────────────────────────
+
+bool StreamCompressor::decompress(Codec codec, std::string& data, std::string& error) {
+    if (codec == kNone) return true;
+    if (!available(codec)) {
+        error = std::string(name(codec)) + " support was not built in";
+        return false;
+    }
+    std::string out;
+
+#ifdef M2P_HAVE_ZLIB
+    if (codec == kGzip) {
+        // The trailer holds the size mod 2^32: a good first guess.
+        if (data.size() >= 18) {
+            uint32_t isize;
+            std::memcpy(&isize, data.data() + data.size() - 4, 4);
+            if (isize >= data.size()) out.reserve(isize);
+        }
+        z_stream z = {};
+        if (inflateInit2(&z, 15 + 32) != Z_OK) {
+            error = "cannot start gzip decoder";
+            return false;
+        }
+        z.next_in  = reinterpret_cast<Bytef*>(data.data());
+        z.avail_in = static_cast<uInt>(data.size());   // charts stay far below 4 GB compressed
+        int rc = Z_OK;
+        while (rc != Z_STREAM_END || z.avail_in > 0) {
+            if (rc == Z_STREAM_END) inflateReset(&z);   // concatenated members
+            const size_t used = out.size();
+            out.resize(std::max(out.capacity(), used + kChunk));
+            z.next_out  = reinterpret_cast<Bytef*>(&out[used]);
+            z.avail_out = static_cast<uInt>(out.size() - used);
+            rc = inflate(&z, Z_NO_FLUSH);
+            out.resize(out.size() - z.avail_out);
+            if (rc != Z_OK && rc != Z_STREAM_END) {
+                error = std::string("corrupt gzip data") + (z.msg ? ": " : "") + (z.msg ? z.msg : "");
+                inflateEnd(&z);
+                return false;
+            }
+            if (rc == Z_OK && z.avail_in == 0 && z.avail_out > 0) {
+                inflateEnd(&z);
+                error = "truncated gzip data";
+                return false;
+            }
+        }
+        inflateEnd(&z);
+    }
+#endif
+#ifdef M2P_HAVE_ZSTD
+    if (codec == kZstd) {
+        const unsigned long long known = ZSTD_getFrameContentSize(data.data(), data.size());
+        if (known != ZSTD_CONTENTSIZE_UNKNOWN && known != ZSTD_CONTENTSIZE_ERROR)
+            out.reserve(static_cast<size_t>(known));
+        ZSTD_DCtx*     dctx = ZSTD_createDCtx();
+        ZSTD_inBuffer  in   = {data.data(), data.size(), 0};
+        size_t         rc   = 1;
+        while (in.pos < in.size || rc != 0) {
+            const size_t used = out.size();
+            out.resize(std::max(out.capacity(), used + kChunk));
+            ZSTD_outBuffer o = {&out[used], out.size() - used, 0};
+            rc = ZSTD_decompressStream(dctx, &o, &in);
+            out.resize(used + o.pos);
+            if (ZSTD_isError(rc)) {
+                error = std::string("corrupt zstd data: ") + ZSTD_getErrorName(rc);
+                ZSTD_freeDCtx(dctx);
+                return false;
+            }
+            if (in.pos == in.size && rc != 0 && o.pos < o.size) {
+                error = "truncated zstd data";
+                ZSTD_freeDCtx(dctx);
+                return false;
+            }
+        }
+        ZSTD_freeDCtx(dctx);
+    }
+#endif
+
+    data.swap(out);
+    return true;
+}
+
+// ─── Streaming compression ────────────────────────────────────────────────────
+
+StreamCompressor::~StreamCompressor() { end(); }
+
+bool StreamCompressor::begin(Codec codec, int level, std::string& error) {
+    end();
+    if (!available(codec)) {
+        error = std::string(name(codec)) + " support was not built in";
+        return false;
+    }
+    m_codec = codec;
+    m_level = level > 0 ? level : defaultLevel(codec);
+
+#ifdef M2P_HAVE_ZLIB
+    if (codec == kGzip) {
+        auto* z = new z_stream{};
+        // 15 + 16: largest window, gzip header and trailer.
+        if (deflateInit2(z, m_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            delete z;
+            error = "cannot start gzip encoder";
+            return false;
+        }
+        m_stream = z;
+    }
+#endif
+#ifdef M2P_HAVE_ZSTD
+    if (codec == kZstd) {
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        if (!cctx || ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, m_level))) {
+            ZSTD_freeCCtx(cctx);
+            error = "cannot start zstd encoder";
+            return false;
+        }
+        // Multi-threaded libzstd compresses on workers of its own; a
+        // single-threaded build rejects this and compresses inline.
+        const unsigned hw = std::thread::hardware_concurrency();
+        if (hw > 2) ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, static_cast<int>(hw / 2));
+        m_stream = cctx;
+    }
+#endif
+    return true;
+}
+
+bool StreamCompressor::compress(const char* data, size_t size, std::string& out, bool finish,
+                                std::string& error) {
+    if (!m_stream) {
+        error = "no compression stream";
+        return false;
+    }
+#ifdef M2P_HAVE_ZLIB
+    if (m_codec == kGzip) {
+        auto* z = static_cast<z_stream*>(m_stream);
+        z->next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        z->avail_in = static_cast<uInt>(size);   // buffers are far below 4 GB
+        int rc;
+        do {
+            const size_t used = out.size();
+            out.resize(used + std::max(kChunk, static_cast<size_t>(deflateBound(z, z->avail_in))));
+            z->next_out  = reinterpret_cast<Bytef*>(&out[used]);
+            z->avail_out = static_cast<uInt>(out.size() - used);
+            rc = deflate(z, finish ? Z_FINISH : Z_NO_FLUSH);
+            out.resize(out.size() - z->avail_out);
+            if (rc == Z_STREAM_ERROR) {
+                error = "gzip encoder failed";
+                return false;
+            }
+        } while (z->avail_in > 0 || (finish && rc != Z_STREAM_END));
+        if (finish) end();
+        return true;
+    }
+#endif
+#ifdef M2P_HAVE_ZSTD
+    if (m_codec == kZstd) {
+        auto*         cctx = static_cast<ZSTD_CCtx*>(m_stream);
+        ZSTD_inBuffer in   = {data, size, 0};
+        size_t        rc;
+        do {
+            const size_t used = out.size();
+            out.resize(used + std::max(kChunk, ZSTD_compressBound(in.size - in.pos)));
+            ZSTD_outBuffer o = {&out[used], out.size() - used, 0};
+            rc = ZSTD_compressStream2(cctx, &o, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+            out.resize(used + o.pos);
+            if (ZSTD_isError(rc)) {
+                error = std::string("zstd encoder failed: ") + ZSTD_getErrorName(rc);
+                return false;
+            }
+        } while (in.pos < in.size || (finish && rc != 0));
+        if (finish) end();
+        return true;
+    }
+#endif
+    (void)data; (void)size; (void)out; (void)finish;
+    error = std::string(name(m_codec)) + " support was not built in";
+    return false;
+}
+
+void StreamCompressor::end() {
+    if (!m_stream) return;
+#ifdef M2P_HAVE_ZLIB
+    if (m_codec == kGzip) {
+        deflateEnd(static_cast<z_stream*>(m_stream));
+        delete static_cast<z_stream*>(m_stream);
+    }
+#endif
+#ifdef M2P_HAVE_ZSTD
+    if (m_codec == kZstd) ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(m_stream));
+#endif
+    m_stream = nullptr;
+}
@@ -0,0 +1,68 @@
+#include "tempo_map.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ─── Constructor ──────────────────────────────────────────────────────────────
+
+TempoMap::TempoMap(uint16_t ppq, const std::vector<TempoChange>& changes, double multiplier) {
+    // Multiplier as the exact ratio multNum / 1e6.
+    int64_t multNum = std::llround(multiplier * 1e6);
+    multNum = std::max<int64_t>(1, std::min<int64_t>(multNum, 1000000000000LL));
+    const uint64_t den = static_cast<uint64_t>(std::max<uint16_t>(ppq, 1)) *
+                         static_cast<uint64_t>(multNum);
+
+    // ns/tick = uspqn * 1000 / (ppq * multiplier) = uspqn * 1e9 / den, as Q24
+    // by long division so no intermediate needs more than 64 bits.
+    auto factor = [den](uint32_t uspqn) -> uint64_t {
+        uint64_t num = static_cast<uint64_t>(uspqn) * 1000000000ull;
+        uint64_t q   = num / den, r = num % den;
+        if (q >> (64 - kFracBits)) return UINT64_MAX;   // degenerate tempo/ppq
+        for (int i = 0; i < kFracBits / 8; ++i) {
+            r <<= 8;
+            q  = (q << 8) | (r / den);
+            r %= den;
+        }
+        return q;
+    };
+
+    std::vector<TempoChange> sorted = changes;
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const TempoChange& a, const TempoChange& b) { return a.tick < b.tick; });
+
+    // Before the first change the first tempo applies (120 BPM with none).
+    uint32_t firstUs = sorted.empty() ? 500000u : sorted.front().usPerQuarter;
+    m_segments.push_back({0, 0, 0, factor(firstUs)});
+
+    const uint64_t fracMask = (uint64_t(1) << kFracBits) - 1;
+    for (const auto& tc : sorted) {
+        Segment& last = m_segments.back();
+        if (tc.tick == last.startTick) {
+            last.nsPerTick = factor(tc.usPerQuarter);
+            continue;
+        }
+        uint64_t dt = tc.tick - last.startTick;
+        Segment  next;
+        next.startTick = tc.tick;
+        next.startNs   = last.startNs +
+                         static_cast<int64_t>(mulAddShiftQ24(dt, last.nsPerTick, last.startFrac));
+        next.startFrac = static_cast<uint32_t>((dt * last.nsPerTick + last.startFrac) & fracMask);
+        next.nsPerTick = factor(tc.usPerQuarter);
+        m_segments.push_back(next);
+    }
+}
+
+// ─── Inverse ──────────────────────────────────────────────────────────────────
+
+uint32_t TempoMap::nsToTick(int64_t ns) const {
+    if (ns <= 0) return 0;
+    // ticksToNs is non-decreasing in tick: bisect for the first tick >= ns.
+    uint64_t lo = 0, hi = UINT32_MAX;
+    if (ticksToNs(UINT32_MAX) < ns) return UINT32_MAX;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (ticksToNs(static_cast<uint32_t>(mid)) >= ns) hi = mid;
+        else                                             lo = mid + 1;
+    }
+    return static_cast<uint32_t>(lo);
+}